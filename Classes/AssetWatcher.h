@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// File watching is only available through inotify on Linux
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/*
+    Asset Watcher class implementation. Watches asset files (.obj files, textures, and shaders) for changes
+    and hot-reloads only the resources that depend on a changed file.
+
+    Files are re-imported on a background thread. The resulting GPU resources are swapped in by the
+    main (OpenGL) thread at a frame boundary through applyPendingReloads(). If a reload fails, nothing
+    is queued and the old version of the resource stays live.
+ */
+class AssetWatcher {
+public:
+    // Runs on the watcher thread and re-imports an asset from disk. Returns the step that swaps
+    // the new resource in on the OpenGL thread, or an empty function if the re-import failed.
+    typedef std::function<std::function<void()>()> ReloadFunc;
+
+private:
+    // Reload functions of every watched file, keyed by the file's path
+    std::unordered_map<std::string, std::vector<ReloadFunc>> watchedFiles;
+    // Directories containing the watched files, keyed by their inotify watch descriptor
+    std::unordered_map<int, std::string> watchedDirs;
+
+    // Swap steps ready to be applied at the next frame boundary, keyed by the changed file's path
+    std::map<std::string, std::vector<std::function<void()>>> pendingReloads;
+    // Guards pendingReloads between the watcher thread and the OpenGL thread
+    std::mutex pendingMutex;
+
+    // Background thread that waits for file events and re-imports changed files
+    std::thread watcherThread;
+    // Flag that keeps the watcher thread running
+    std::atomic<bool> running;
+    // File descriptor of the inotify instance
+    int inotifyFD;
+
+    // Time (in milliseconds) to wait for more events after a change; editors often write a file in bursts
+    const int DEBOUNCE_MS = 100;
+    // Time (in milliseconds) to block while polling for events before checking if the watcher is stopped
+    const int POLL_TIMEOUT_MS = 250;
+
+    // Returns the directory part of a file path ("." if there is none).
+    static std::string getDirectory(const std::string& path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    // Returns the file name part of a file path.
+    static std::string getFileName(const std::string& path) {
+        size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+#ifdef __linux__
+    // Reads all queued inotify events and collects the paths of watched files that changed.
+    void readEvents(std::set<std::string>& changedPaths) {
+        // Buffer aligned for inotify_event structures
+        alignas(struct inotify_event) char buffer[4096];
+
+        ssize_t length = read(inotifyFD, buffer, sizeof(buffer));
+        for (char* ptr = buffer; length > 0 && ptr < buffer + length; ) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            // Ignore events without a file name or from directories that are not ours
+            auto dir = watchedDirs.find(event->wd);
+            if (event->len == 0 || dir == watchedDirs.end())
+                continue;
+
+            // Only keep files that are actually watched; directories hold other assets as well
+            std::string path = dir->second == "." ? event->name : dir->second + "/" + event->name;
+            if (watchedFiles.count(path) > 0)
+                changedPaths.insert(path);
+        }
+    }
+
+    // Waits for file events and re-imports changed files until the watcher is stopped.
+    void watchLoop() {
+        // Decoded images must be flipped the same way as the initial load; only affects this thread
+        stbi_set_flip_vertically_on_load_thread(true);
+
+        struct pollfd pfd;
+        pfd.fd = inotifyFD;
+        pfd.events = POLLIN;
+
+        while (running) {
+            if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+                continue;
+
+            // Collect changes, then keep collecting until the burst of events settles down
+            std::set<std::string> changedPaths;
+            readEvents(changedPaths);
+            while (running && poll(&pfd, 1, DEBOUNCE_MS) > 0)
+                readEvents(changedPaths);
+
+            for (const std::string& path : changedPaths) {
+                std::cout << "Asset changed, reloading: " << path << std::endl;
+
+                // Re-import every resource that depends on this file
+                std::vector<std::function<void()>> swaps;
+                for (ReloadFunc& reload : watchedFiles[path]) {
+                    std::function<void()> swap = reload();
+                    if (swap)
+                        swaps.push_back(swap);
+                }
+
+                // If every re-import failed, the old resources are kept as they are
+                if (swaps.empty()) {
+                    std::cout << "ERROR: Unable to reload " << path << ", keeping the old version." << std::endl;
+                    continue;
+                }
+
+                // A newer change of the same file replaces a swap that was not applied yet
+                std::lock_guard<std::mutex> lock(pendingMutex);
+                pendingReloads[path] = swaps;
+            }
+        }
+    }
+#endif
+
+public:
+    // Instantiates an Asset Watcher object.
+    AssetWatcher() {
+        this->running = false;
+        this->inotifyFD = -1;
+    }
+
+    // Stops the watcher thread when the watcher goes out of scope.
+    ~AssetWatcher() {
+        stop();
+    }
+
+    // Watches a file; the reload function runs on the watcher thread every time the file changes.
+    // Must be called before start().
+    void watch(const std::string& path, ReloadFunc reload) {
+        this->watchedFiles[path].push_back(reload);
+    }
+
+    // Starts watching the registered files on a background thread.
+    void start() {
+#ifdef __linux__
+        if (this->running)
+            return;
+
+        this->inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (this->inotifyFD < 0) {
+            std::cout << "WARNING: Unable to initialize inotify, hot-reload is disabled." << std::endl;
+            return;
+        }
+
+        // Watch the directories instead of the files themselves, since
+        // editors usually save by replacing the file with a new one
+        std::set<std::string> dirs;
+        for (auto& file : this->watchedFiles)
+            dirs.insert(getDirectory(file.first));
+
+        for (const std::string& dir : dirs) {
+            int wd = inotify_add_watch(this->inotifyFD, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (wd < 0) {
+                std::cout << "WARNING: Unable to watch directory " << dir << std::endl;
+                continue;
+            }
+            this->watchedDirs[wd] = dir;
+        }
+
+        std::cout << "Watching " << this->watchedFiles.size() << " asset files for changes..." << std::endl;
+
+        this->running = true;
+        this->watcherThread = std::thread(&AssetWatcher::watchLoop, this);
+#else
+        std::cout << "WARNING: Asset hot-reload requires inotify and is only available on Linux." << std::endl;
+#endif
+    }
+
+    // Stops the watcher thread. Reloads that were not applied yet are discarded.
+    void stop() {
+#ifdef __linux__
+        if (this->running) {
+            this->running = false;
+            this->watcherThread.join();
+        }
+
+        if (this->inotifyFD >= 0) {
+            close(this->inotifyFD);
+            this->inotifyFD = -1;
+        }
+        this->watchedDirs.clear();
+#endif
+        std::lock_guard<std::mutex> lock(this->pendingMutex);
+        this->pendingReloads.clear();
+    }
+
+    // Swaps in every reloaded resource. Must be called from the OpenGL thread at a frame boundary.
+    // Returns true if any resource was swapped in.
+    bool applyPendingReloads() {
+        // Take the pending reloads so the watcher thread is not blocked while they are applied
+        std::map<std::string, std::vector<std::function<void()>>> reloads;
+        {
+            std::lock_guard<std::mutex> lock(this->pendingMutex);
+            if (this->pendingReloads.empty())
+                return false;
+            reloads.swap(this->pendingReloads);
+        }
+
+        for (auto& reload : reloads) {
+            for (std::function<void()>& swap : reload.second)
+                swap();
+            std::cout << "Reloaded " << reload.first << std::endl;
+        }
+        return true;
+    }
+};
@@ -4,6 +4,10 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cfloat>
+
+#include "UniformBuffer.h"
 
 /* 
 	Abstract Camera class implementation. Parent class for every camera-related functionality.
@@ -24,6 +28,21 @@ protected:
 	float zNear;
 	// zFar value of the camera
 	float zFar;
+	// Largest far plane distance (e.g. where the fog turns opaque); the far plane is pulled in to it if nearer than zFar
+	float maxZFar = FLT_MAX;
+
+	// Writes the given camera attributes into the camera uniform block.
+	void writeBlock(CameraBlock& block, const glm::mat4& projection, const glm::mat4& view) {
+		block.projection = projection;
+		block.view = view;
+		block.cameraPos = this->position;
+		block.zFar = this->computeFarPlane();
+	}
+
+	// Returns the distance of the far plane; zFar, pulled in to the largest far plane distance.
+	float computeFarPlane() {
+		return std::min(this->zFar, this->maxZFar);
+	}
 
 	// Update the camera's center.
 	void updateCamera() {
@@ -37,12 +56,14 @@ protected:
 	}
 
 public:
-	// Bind the attributes of this camera to the specified shader. To be implemented.
-	virtual void bindToShader(Shader shader, bool isSkybox = false) = 0;
-
 	// Compute for the projection matrix of this camera.
 	virtual glm::mat4 computeProjectionMatrix() = 0;
 
+	// Bind the attributes of this camera to the camera uniform block shared by every shader.
+	void bindToBlock(CameraBlock& block) {
+		writeBlock(block, this->computeProjectionMatrix(), this->computeViewMatrix());
+	}
+
 	// Compute for the view matrix and return it.
 	glm::mat4 computeViewMatrix() {
 		return glm::lookAt(this->position, this->center, this->worldUp);
@@ -114,6 +135,11 @@ public:
 	float getZFar() {
 		return this->zFar;
 	}
+
+	// Sets the largest far plane distance; FLT_MAX keeps the far plane at zFar.
+	void setMaxZFar(float maxZFar) {
+		this->maxZFar = maxZFar;
+	}
 };
 
 /*
@@ -162,23 +188,6 @@ public:
 		updateCamera();
 	}
 
-	// Virtual function implementation. Bind the attributes of this Orthographic Camera to the specified shader.
-	void bindToShader(Shader shader, bool isSkybox = false) {
-		shader.setVec3("cameraPos", this->position);
-		shader.setMat4("projection", this->computeProjectionMatrix());
-
-		// If shader is intended for a skybox, modify view matrix
-		if (isSkybox) {
-			glm::mat4 sky_view = glm::mat4(1.0f);
-			sky_view = glm::mat4(glm::mat3(this->computeViewMatrix()));
-			shader.setMat4("view", sky_view);
-		}
-		// Else, just use the usual computation
-		else {
-			shader.setMat4("view", this->computeViewMatrix());
-		}
-	}
-
 	// Virtual function implementation. Compute for the projection matrix of this camera.
 	glm::mat4 computeProjectionMatrix() {
 		return glm::ortho(
@@ -187,7 +196,7 @@ public:
 			this->bottom,
 			this->top,
 			this->zNear,
-			this->zFar
+			this->computeFarPlane()
 		);
 	}
 };
@@ -230,48 +239,19 @@ public:
 		updateCamera();
 	}
 
-	// Virtual function implementation. Binds the attributes of this Perspective Camera to the specified shader.
-	void bindToShader(Shader shader, bool isSkybox = false) {
-		shader.setVec3("cameraPos", this->position);
-		shader.setMat4("projection", this->computeProjectionMatrix());
-
-		// If shader is intended for a skybox, modify view matrix
-		if (isSkybox) {
-			glm::mat4 sky_view = glm::mat4(1.0f);
-			sky_view = glm::mat4(glm::mat3(this->computeViewMatrix()));
-			shader.setMat4("view", sky_view);
-		}
-		// Else, just use the usual computation
-		else {
-			shader.setMat4("view", this->computeViewMatrix());
-		}
-	}
-
 	// Virtual function implementation. Compute for the projection matrix of this camera.
 	glm::mat4 computeProjectionMatrix() {
 		return glm::perspective(
 			this->fieldOfView,
 			this->aspectRatio,
 			this->zNear,
-			this->zFar
+			this->computeFarPlane()
 		);
 	}
 
 	// Bind the attributes of this camera based on first person POV movement.
-	void bindToShaderFirstPOV(Shader shader, bool isSkybox = false) {
-		shader.setVec3("cameraPos", this->position);
-		shader.setMat4("projection", this->computeProjectionMatrix());
-
-		// If shader is intended for a skybox, modify view matrix
-		if (isSkybox) {
-			glm::mat4 sky_view = glm::mat4(1.0f);
-			sky_view = glm::mat4(glm::mat3(this->computeViewMatrixFirstPOV()));
-			shader.setMat4("view", sky_view);
-		}
-		// Else, just use the usual computation
-		else {
-			shader.setMat4("view", this->computeViewMatrixFirstPOV());
-		}
+	void bindToBlockFirstPOV(CameraBlock& block) {
+		writeBlock(block, this->computeProjectionMatrix(), this->computeViewMatrixFirstPOV());
 	}
 
 	// Computes the view matrix of this camera based on first person POV movement.
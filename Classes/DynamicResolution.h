@@ -0,0 +1,212 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+
+#include "GLState.h"
+#include "Shader.h"
+
+/*
+    Dynamic Resolution class implementation. Measures the GPU time of every frame with timer queries and
+    picks the fraction of the window's resolution the 3D passes are drawn at, so that the frame time stays
+    near a target (see FrameGraph::setResolutionScale). The scaled scene is then stretched to the window
+    with a bilinear and sharpening pass (see upscale.frag).
+
+    Timer results arrive a few frames late and are read without waiting. The scale drops as soon as the
+    smoothed frame time exceeds the target, by the amount the pixel count has to shrink; it only rises
+    again, one step at a time, once frames stay well under the target, so that it does not oscillate.
+ */
+class DynamicResolution {
+private:
+    // Uniform handles of the upscaling shader
+    struct UpscaleUniforms {
+        Uniform<int> sceneColor;
+        Uniform<glm::vec2> uvScale;
+        Uniform<glm::vec2> texelSize;
+        Uniform<glm::vec2> outputSize;
+        Uniform<float> sharpness;
+
+        UpscaleUniforms(const Shader& shader) {
+            this->sceneColor = shader.getUniform<int>("sceneColor");
+            this->uvScale = shader.getUniform<glm::vec2>("uvScale");
+            this->texelSize = shader.getUniform<glm::vec2>("texelSize");
+            this->outputSize = shader.getUniform<glm::vec2>("outputSize");
+            this->sharpness = shader.getUniform<float>("sharpness");
+        }
+    };
+    // Cached uniform handles of the upscaling shader
+    UniformCache<UpscaleUniforms> uniforms;
+
+    // Number of timer queries in flight; results are read this many frames late at most
+    static const int QUERY_COUNT = 4;
+    // Range of the resolution scale
+    const float MIN_SCALE = 0.5f;
+    const float MAX_SCALE = 1.0f;
+    // Smallest change of the scale
+    const float SCALE_STEP = 0.05f;
+    // Fraction of the target the frame time must stay under before the scale rises
+    const float HEADROOM = 0.8f;
+    // Number of frames the frame time must stay under the headroom before the scale rises
+    const int RAISE_DELAY = 60;
+    // Weight of a new frame time in the smoothed frame time
+    const float SMOOTHING = 0.2f;
+    // Sharpening at the minimum scale; none at full resolution
+    const float MAX_SHARPNESS = 0.5f;
+    // Texture unit the scene is sampled from
+    const GLenum SCENE_UNIT = GL_TEXTURE0;
+
+    // Shader stretching the scene to the window
+    Shader* upscaleShader;
+    // Empty vertex array; the fullscreen triangle is generated from the vertex IDs
+    GLuint VAO;
+
+    // Timer queries of the last frames, used as a ring
+    GLuint queries[QUERY_COUNT];
+    // Flag per query to determine if its result was not read yet
+    bool isPending[QUERY_COUNT];
+    // Query measuring this frame (-1 if every query is in flight)
+    int currentQuery;
+    // Next query of the ring
+    int nextQuery;
+
+    // GPU time to aim for per frame (in milliseconds)
+    float targetFrameTime;
+    // Smoothed GPU time per frame (in milliseconds; 0 before the first result)
+    float frameTime;
+    // Fraction of the window's width and height the 3D passes are drawn at
+    float scale;
+    // Number of consecutive frames under the headroom
+    int fastFrameCount;
+    // Number of results left that were measured before the last change of the scale
+    int staleResultCount;
+
+    // Adjusts the scale to a measured frame time (in milliseconds).
+    void update(float measuredFrameTime) {
+        // Frames in flight when the scale changed do not show the change yet
+        if (this->staleResultCount > 0) {
+            this->staleResultCount--;
+            return;
+        }
+
+        this->frameTime = this->frameTime > 0.0f ? glm::mix(this->frameTime, measuredFrameTime, SMOOTHING) : measuredFrameTime;
+
+        float newScale = this->scale;
+        if (this->frameTime > this->targetFrameTime) {
+            // The cost follows the pixel count, which is the square of the scale
+            newScale = this->scale * std::sqrt(this->targetFrameTime / this->frameTime);
+            newScale = std::floor(newScale / SCALE_STEP) * SCALE_STEP;
+            this->fastFrameCount = 0;
+        }
+        else if (this->frameTime < this->targetFrameTime * HEADROOM) {
+            if (++this->fastFrameCount >= RAISE_DELAY) {
+                newScale = this->scale + SCALE_STEP;
+                this->fastFrameCount = 0;
+            }
+        }
+        else
+            this->fastFrameCount = 0;
+
+        newScale = std::min(std::max(newScale, MIN_SCALE), MAX_SCALE);
+        if (std::abs(newScale - this->scale) < SCALE_STEP * 0.5f)
+            return;
+
+        // Start over from the cost of the new scale
+        this->scale = newScale;
+        this->frameTime = 0.0f;
+        this->staleResultCount = QUERY_COUNT;
+    }
+
+public:
+    // Instantiates a Dynamic Resolution object aiming for the given GPU time per frame (in milliseconds),
+    // upscaling with the given shader (see fullscreen.vert and upscale.frag).
+    DynamicResolution(Shader* upscaleShader, float targetFrameTime) {
+        this->upscaleShader = upscaleShader;
+        this->targetFrameTime = targetFrameTime;
+        this->frameTime = 0.0f;
+        this->scale = MAX_SCALE;
+        this->fastFrameCount = 0;
+        this->staleResultCount = 0;
+        this->currentQuery = -1;
+        this->nextQuery = 0;
+
+        glGenQueries(QUERY_COUNT, this->queries);
+        for (int i = 0; i < QUERY_COUNT; i++)
+            this->isPending[i] = false;
+
+        glGenVertexArrays(1, &this->VAO);
+    }
+
+    // Starts measuring the GPU time of the frame; skipped if every query is still in flight.
+    void beginFrame() {
+        this->currentQuery = -1;
+        if (this->isPending[this->nextQuery])
+            return;
+
+        this->currentQuery = this->nextQuery;
+        this->nextQuery = (this->nextQuery + 1) % QUERY_COUNT;
+        glBeginQuery(GL_TIME_ELAPSED, this->queries[this->currentQuery]);
+    }
+
+    // Stops measuring the frame, and adjusts the scale to the results that arrived, oldest first.
+    void endFrame() {
+        if (this->currentQuery >= 0) {
+            glEndQuery(GL_TIME_ELAPSED);
+            this->isPending[this->currentQuery] = true;
+        }
+
+        for (int i = 0; i < QUERY_COUNT; i++) {
+            int query = (this->nextQuery + i) % QUERY_COUNT;
+            if (!this->isPending[query])
+                continue;
+
+            GLint isAvailable = 0;
+            glGetQueryObjectiv(this->queries[query], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+            if (!isAvailable)
+                break;
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(this->queries[query], GL_QUERY_RESULT, &elapsed);
+            this->isPending[query] = false;
+            this->update((float)(elapsed / 1.0e6));
+        }
+    }
+
+    // Draws the scene (the drawn part of the given texture) stretched over the bound framebuffer.
+    // Nothing is drawn until the shader finished compiling.
+    void upscale(GLuint sceneTexture, GLsizei textureWidth, GLsizei textureHeight, GLsizei drawnWidth, GLsizei drawnHeight,
+        GLsizei outputWidth, GLsizei outputHeight) {
+        if (!this->upscaleShader->isReady())
+            return;
+
+        GLState::setDepthTest(false);
+        GLState::setBlend(false);
+        GLState::setColorMask(true);
+
+        this->upscaleShader->use();
+        const UpscaleUniforms& uniforms = this->uniforms.get(*this->upscaleShader);
+        GLState::bindTexture(SCENE_UNIT, GL_TEXTURE_2D, sceneTexture);
+        uniforms.sceneColor.set(SCENE_UNIT - GL_TEXTURE0);
+        uniforms.uvScale.set(glm::vec2((float)drawnWidth / textureWidth, (float)drawnHeight / textureHeight));
+        uniforms.texelSize.set(glm::vec2(1.0f / textureWidth, 1.0f / textureHeight));
+        uniforms.outputSize.set(glm::vec2((float)outputWidth, (float)outputHeight));
+
+        // Sharpen more the further the scene is stretched
+        float stretch = 1.0f - (float)drawnWidth / outputWidth;
+        uniforms.sharpness.set(std::max(stretch, 0.0f) / (MAX_SCALE - MIN_SCALE) * MAX_SHARPNESS);
+
+        GLState::bindVertexArray(this->VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // Returns the fraction of the window's width and height the 3D passes are drawn at.
+    float getScale() {
+        return this->scale;
+    }
+
+    // Returns the smoothed GPU time per frame (in milliseconds; 0 until a result arrives after a change of scale).
+    float getFrameTime() {
+        return this->frameTime;
+    }
+};
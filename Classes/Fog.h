@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "UniformBuffer.h"
+
+/*
+    Fog class implementation. Underwater exponential fog: the light of a fragment reaches the camera
+    attenuated by exp(-density * distance) over the part of the ray below the water's surface (see
+    main.frag). The water grows murkier and darker with depth, so the density and the color follow the
+    depth of a reference point (the submarine).
+
+    Past the distance where the fog lets through less than one step of an 8-bit color, nothing can be seen.
+    Cameras pull their far plane in to it (see Camera::setMaxZFar), which culls everything beyond it and
+    spends the depth buffer's precision on the visible range only.
+ */
+class Fog {
+private:
+    // Height of the water's surface
+    const float SURFACE_HEIGHT = 0.0f;
+    // Distance at which the fog turns opaque just below the surface
+    const float SURFACE_VISIBILITY = 1000.0f;
+    // Increase of the density per unit of depth
+    const float DENSITY_PER_DEPTH = 0.00004f;
+    // Color of the water just below the surface
+    const glm::vec3 SURFACE_COLOR = glm::vec3(0.05f, 0.55f, 0.7f);
+    // Fraction of the surface's light absorbed per unit of depth; the water darkens further down
+    const float LIGHT_ABSORPTION = 0.002f;
+    // Fraction of the light let through at the opaque distance; less than one step of an 8-bit color
+    const float OPAQUE_TRANSMITTANCE = 1.0f / 256.0f;
+
+    // Fraction of the light scattered away per unit of distance
+    float density;
+    // Color the fog turns to where it is opaque
+    glm::vec3 color;
+    // Fraction of the skybox covered by the fog's color
+    float skyAmount;
+
+public:
+    // Instantiates a Fog object tuned to the water just below the surface.
+    Fog() {
+        this->update(SURFACE_HEIGHT);
+    }
+
+    // Tunes the fog to the depth of the given height (e.g. the submarine's).
+    void update(float height) {
+        float depth = std::max(SURFACE_HEIGHT - height, 0.0f);
+        float surfaceDensity = -std::log(OPAQUE_TRANSMITTANCE) / SURFACE_VISIBILITY;
+        this->density = surfaceDensity + depth * DENSITY_PER_DEPTH;
+        this->color = SURFACE_COLOR * std::exp(-depth * LIGHT_ABSORPTION);
+
+        // The skybox already shows the haze of the water near the surface; the murk added since then covers it
+        this->skyAmount = 1.0f - surfaceDensity / this->density;
+    }
+
+    // Bind the attributes of this fog to the fog uniform block.
+    void bindToBlock(FogBlock& block) {
+        block.color = this->color;
+        block.density = this->density;
+        block.surfaceHeight = SURFACE_HEIGHT;
+        block.skyAmount = this->skyAmount;
+    }
+
+    // Returns the distance under the water past which the fog is opaque.
+    float getOpaqueDistance() {
+        return -std::log(OPAQUE_TRANSMITTANCE) / this->density;
+    }
+
+    // Returns the farthest distance anything can be seen at from a camera at the given height; FLT_MAX if unbounded.
+    // Rays above the surface are not fogged, so only a camera looking straight down from above it is bounded there.
+    float computeMaxZFar(float cameraHeight, bool isLookingStraightDown) {
+        if (cameraHeight <= SURFACE_HEIGHT)
+            return this->getOpaqueDistance();
+        if (isLookingStraightDown)
+            return this->getOpaqueDistance() + (cameraHeight - SURFACE_HEIGHT);
+        return FLT_MAX;
+    }
+
+    // Returns the color the fog turns to where it is opaque.
+    glm::vec3 getColor() {
+        return this->color;
+    }
+};
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "GLState.h"
+
+// Handle to a resource of a frame graph
+typedef int FrameResource;
+// Handle that refers to no resource
+const FrameResource NO_FRAME_RESOURCE = -1;
+
+// Description of a render target created by a frame graph.
+struct FrameTextureDesc {
+    GLsizei width;
+    GLsizei height;
+    // Sized internal format (i.e., GL_RGBA8, GL_DEPTH_COMPONENT24)
+    GLenum internalFormat;
+
+    bool operator==(const FrameTextureDesc& other) const {
+        return this->width == other.width && this->height == other.height && this->internalFormat == other.internalFormat;
+    }
+};
+
+/*
+    Frame Graph class implementation. Describes a frame as passes that declare the render targets they
+    read and write; the graph derives everything else:
+    - Order: a pass runs after every pass writing a resource it reads. Passes writing the same resource
+      keep the order they were added in.
+    - Culling: passes whose results never reach the window (or another pass with side effects) are dropped.
+    - Render targets: transient targets are taken from a pool. Targets whose lifetimes do not overlap
+      share the same texture, and the textures and framebuffers are kept between frames.
+    - Transitions: before each pass, its framebuffer and viewport are bound and its targets are cleared
+      on their first write, if requested.
+    - Resolution scaling: scaled targets are allocated at full size, but passes writing them only draw
+      into the part sized by the graph's resolution scale, which may change every frame for free.
+
+    The graph is set up and compiled once; execute() then runs it every frame without allocating.
+ */
+class FrameGraph {
+public:
+    class Builder;
+    // Declares the resources of a pass
+    typedef std::function<void(Builder&)> SetupFunction;
+    // Draws a pass; resources are looked up through the graph
+    typedef std::function<void(const FrameGraph&)> ExecuteFunction;
+
+private:
+    // A render target used by the passes
+    struct Resource {
+        std::string name;
+        FrameTextureDesc desc;
+        // Imported resources belong to the window's framebuffer; the others are transient
+        bool isImported;
+        // Passes draw into the part of the target sized by the resolution scale
+        bool isScaled;
+        // Pool texture holding a transient resource (valid after compile)
+        int pooledTexture;
+        // Passes writing and reading the resource, in the order they were added
+        std::vector<int> writers;
+        std::vector<int> readers;
+    };
+
+    // A step of the frame
+    struct Pass {
+        std::string name;
+        ExecuteFunction execute;
+        std::vector<FrameResource> reads;
+        std::vector<FrameResource> writes;
+        // Written resources to be cleared before the pass
+        std::vector<FrameResource> clears;
+        // The pass must run even if nothing reads its results
+        bool hasSideEffect;
+        // Framebuffer drawn into (valid after compile)
+        GLuint framebuffer;
+        // Size of the written targets (valid after compile)
+        GLsizei width;
+        GLsizei height;
+        // The written targets are scaled by the resolution scale (valid after compile)
+        bool isScaled;
+        // Buffers cleared before the pass (valid after compile)
+        GLbitfield clearMask;
+    };
+
+    // A texture of the pool; kept between compiles and frames
+    struct PooledTexture {
+        FrameTextureDesc desc;
+        GLuint texture;
+        // The texture holds a resource during the part of the frame being allocated
+        bool isInUse;
+    };
+
+public:
+    // Declares the resources of a pass while it is added.
+    class Builder {
+    private:
+        FrameGraph& graph;
+        int pass;
+
+    public:
+        // Instantiates a Builder object for the pass at the given index.
+        Builder(FrameGraph& graph, int pass) : graph(graph) {
+            this->pass = pass;
+        }
+
+        // Creates a transient render target; it only exists between its first and last use.
+        // Passes only draw into the part of a scaled target sized by the resolution scale (see setResolutionScale).
+        FrameResource create(const std::string& name, const FrameTextureDesc& desc, bool isScaled = false) {
+            FrameResource resource = this->graph.addResource(name, desc, false);
+            this->graph.resources[resource].isScaled = isScaled;
+            return resource;
+        }
+
+        // Declares that the pass samples or otherwise reads the resource.
+        FrameResource read(FrameResource resource) {
+            this->graph.passes[this->pass].reads.push_back(resource);
+            this->graph.resources[resource].readers.push_back(this->pass);
+            return resource;
+        }
+
+        // Declares that the pass draws into the resource, clearing it first if requested.
+        FrameResource write(FrameResource resource, bool clear = false) {
+            this->graph.passes[this->pass].writes.push_back(resource);
+            this->graph.resources[resource].writers.push_back(this->pass);
+            if (clear)
+                this->graph.passes[this->pass].clears.push_back(resource);
+            return resource;
+        }
+
+        // Keeps the pass even if nothing reads what it writes.
+        void setSideEffect() {
+            this->graph.passes[this->pass].hasSideEffect = true;
+        }
+    };
+
+private:
+    // Resources declared by the passes
+    std::vector<Resource> resources;
+    // Passes, in the order they were added
+    std::vector<Pass> passes;
+    // Passes to run, in execution order (valid after compile)
+    std::vector<int> order;
+    // Flag to determine if the graph was compiled since it was last changed
+    bool isCompiled;
+    // Fraction of the width and height of scaled targets drawn into this frame
+    float resolutionScale;
+
+    // Textures of the pool
+    std::vector<PooledTexture> texturePool;
+    // Framebuffers of the pool, keyed by their attachments
+    std::map<std::vector<GLuint>, GLuint> framebufferPool;
+
+    // Adds a resource and returns its handle.
+    FrameResource addResource(const std::string& name, const FrameTextureDesc& desc, bool isImported) {
+        Resource resource;
+        resource.name = name;
+        resource.desc = desc;
+        resource.isImported = isImported;
+        resource.isScaled = false;
+        resource.pooledTexture = -1;
+        this->resources.push_back(resource);
+        this->isCompiled = false;
+        return (FrameResource)this->resources.size() - 1;
+    }
+
+    // Returns true if the internal format holds depth.
+    static bool isDepthFormat(GLenum internalFormat) {
+        return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 ||
+            internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH24_STENCIL8 ||
+            internalFormat == GL_DEPTH32F_STENCIL8;
+    }
+
+    // Marks the passes whose results are used; returns the flags per pass.
+    std::vector<bool> findUsedPasses() const {
+        std::vector<bool> isUsed(this->passes.size(), false);
+        std::vector<int> pending;
+
+        // Passes reaching the window or with side effects are always used
+        for (int i = 0; i < (int)this->passes.size(); i++) {
+            bool writesImported = false;
+            for (FrameResource resource : this->passes[i].writes)
+                writesImported = writesImported || this->resources[resource].isImported;
+
+            if (writesImported || this->passes[i].hasSideEffect) {
+                isUsed[i] = true;
+                pending.push_back(i);
+            }
+        }
+
+        // So are the passes writing what a used pass reads
+        while (!pending.empty()) {
+            int pass = pending.back();
+            pending.pop_back();
+
+            for (FrameResource resource : this->passes[pass].reads) {
+                for (int writer : this->resources[resource].writers) {
+                    if (!isUsed[writer]) {
+                        isUsed[writer] = true;
+                        pending.push_back(writer);
+                    }
+                }
+            }
+        }
+
+        return isUsed;
+    }
+
+    // Orders the used passes; returns false if their dependencies form a cycle.
+    bool orderPasses(const std::vector<bool>& isUsed) {
+        size_t passCount = this->passes.size();
+        std::vector<std::vector<int>> dependents(passCount);
+        std::vector<int> dependencyCount(passCount, 0);
+
+        // Writers of a resource run in the order they were added, and before its readers
+        for (const Resource& resource : this->resources) {
+            for (size_t i = 1; i < resource.writers.size(); i++) {
+                dependents[resource.writers[i - 1]].push_back(resource.writers[i]);
+                dependencyCount[resource.writers[i]]++;
+            }
+            if (resource.writers.empty())
+                continue;
+
+            for (int reader : resource.readers) {
+                // Reading what the pass writes itself is part of the write
+                if (std::find(resource.writers.begin(), resource.writers.end(), reader) != resource.writers.end())
+                    continue;
+                dependents[resource.writers.back()].push_back(reader);
+                dependencyCount[reader]++;
+            }
+        }
+
+        // Take the earliest-added ready pass each time, so independent passes keep their order
+        this->order.clear();
+        std::vector<bool> isDone(passCount, false);
+        for (size_t step = 0; step < passCount; step++) {
+            int next = -1;
+            for (int i = 0; i < (int)passCount && next < 0; i++) {
+                if (!isDone[i] && dependencyCount[i] == 0)
+                    next = i;
+            }
+            if (next < 0)
+                return false;
+
+            isDone[next] = true;
+            for (int dependent : dependents[next])
+                dependencyCount[dependent]--;
+            if (isUsed[next])
+                this->order.push_back(next);
+        }
+
+        return true;
+    }
+
+    // Returns a pool texture matching the description that is not in use, creating one if needed.
+    int acquireTexture(const FrameTextureDesc& desc) {
+        for (int i = 0; i < (int)this->texturePool.size(); i++) {
+            if (!this->texturePool[i].isInUse && this->texturePool[i].desc == desc) {
+                this->texturePool[i].isInUse = true;
+                return i;
+            }
+        }
+
+        PooledTexture pooled;
+        pooled.desc = desc;
+        pooled.isInUse = true;
+        glGenTextures(1, &pooled.texture);
+        glBindTexture(GL_TEXTURE_2D, pooled.texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        GLState::invalidate();
+
+        this->texturePool.push_back(pooled);
+        return (int)this->texturePool.size() - 1;
+    }
+
+    // Returns the pooled framebuffer with the given attachments, creating it if needed.
+    GLuint acquireFramebuffer(const std::vector<FrameResource>& targets) {
+        std::vector<GLuint> attachments;
+        for (FrameResource resource : targets)
+            attachments.push_back(this->texturePool[this->resources[resource].pooledTexture].texture);
+
+        auto found = this->framebufferPool.find(attachments);
+        if (found != this->framebufferPool.end())
+            return found->second;
+
+        GLuint framebuffer;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (isDepthFormat(this->resources[targets[i]].desc.internalFormat)) {
+                GLenum attachment = this->resources[targets[i]].desc.internalFormat == GL_DEPTH24_STENCIL8 ||
+                    this->resources[targets[i]].desc.internalFormat == GL_DEPTH32F_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[i], 0);
+            }
+            else {
+                GLenum attachment = GL_COLOR_ATTACHMENT0 + (GLenum)drawBuffers.size();
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, attachments[i], 0);
+                drawBuffers.push_back(attachment);
+            }
+        }
+
+        if (drawBuffers.empty())
+            glDrawBuffer(GL_NONE);
+        else
+            glDrawBuffers((GLsizei)drawBuffers.size(), drawBuffers.data());
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR: Frame graph framebuffer is incomplete." << std::endl;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::invalidate();
+
+        this->framebufferPool[attachments] = framebuffer;
+        return framebuffer;
+    }
+
+    // Returns a size scaled by the resolution scale; never below one pixel.
+    GLsizei scaleSize(GLsizei size) const {
+        return std::max((GLsizei)1, (GLsizei)(size * this->resolutionScale + 0.5f));
+    }
+
+    // Assigns pool textures to the transient resources and framebuffers to the passes.
+    bool allocateTargets() {
+        for (PooledTexture& pooled : this->texturePool)
+            pooled.isInUse = false;
+
+        // Last pass (in execution order) using each resource
+        std::vector<int> lastUse(this->resources.size(), -1);
+        for (int step = 0; step < (int)this->order.size(); step++) {
+            const Pass& pass = this->passes[this->order[step]];
+            for (FrameResource resource : pass.reads)
+                lastUse[resource] = step;
+            for (FrameResource resource : pass.writes)
+                lastUse[resource] = step;
+        }
+
+        for (Resource& resource : this->resources)
+            resource.pooledTexture = -1;
+
+        for (int step = 0; step < (int)this->order.size(); step++) {
+            Pass& pass = this->passes[this->order[step]];
+
+            // Resources come alive at their first use
+            bool writesImported = false;
+            bool writesTransient = false;
+            for (FrameResource resource : pass.writes) {
+                Resource& target = this->resources[resource];
+                writesImported = writesImported || target.isImported;
+                writesTransient = writesTransient || !target.isImported;
+                if (!target.isImported && target.pooledTexture < 0)
+                    target.pooledTexture = this->acquireTexture(target.desc);
+            }
+            for (FrameResource resource : pass.reads) {
+                if (!this->resources[resource].isImported && this->resources[resource].pooledTexture < 0) {
+                    std::cout << "ERROR: Frame graph pass \"" << pass.name << "\" reads \"" << this->resources[resource].name << "\" before anything writes it." << std::endl;
+                    return false;
+                }
+            }
+
+            if (writesImported && writesTransient) {
+                std::cout << "ERROR: Frame graph pass \"" << pass.name << "\" writes both the window and offscreen targets." << std::endl;
+                return false;
+            }
+
+            pass.framebuffer = writesTransient ? this->acquireFramebuffer(pass.writes) : 0;
+            pass.width = pass.writes.empty() ? 0 : this->resources[pass.writes[0]].desc.width;
+            pass.height = pass.writes.empty() ? 0 : this->resources[pass.writes[0]].desc.height;
+            pass.isScaled = !pass.writes.empty() && this->resources[pass.writes[0]].isScaled;
+            pass.clearMask = 0;
+            for (FrameResource resource : pass.clears)
+                pass.clearMask |= isDepthFormat(this->resources[resource].desc.internalFormat) ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+
+            // Textures are free for aliasing once their last pass is done
+            for (int i = 0; i < (int)this->resources.size(); i++) {
+                if (lastUse[i] == step && this->resources[i].pooledTexture >= 0)
+                    this->texturePool[this->resources[i].pooledTexture].isInUse = false;
+            }
+        }
+
+        return true;
+    }
+
+public:
+    // Instantiates an empty Frame Graph object.
+    FrameGraph() {
+        this->isCompiled = false;
+        this->resolutionScale = 1.0f;
+    }
+
+    // Deletes the pooled textures and framebuffers when the graph goes out of scope.
+    ~FrameGraph() {
+        for (auto& framebuffer : this->framebufferPool)
+            glDeleteFramebuffers(1, &framebuffer.second);
+        for (PooledTexture& pooled : this->texturePool)
+            glDeleteTextures(1, &pooled.texture);
+    }
+
+    // Imports a buffer of the window's framebuffer; passes writing it are never culled.
+    // Use a depth format for the depth buffer and a color format for the color buffer.
+    FrameResource importWindowTarget(const std::string& name, GLsizei width, GLsizei height, GLenum internalFormat) {
+        FrameTextureDesc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.internalFormat = internalFormat;
+        return this->addResource(name, desc, true);
+    }
+
+    // Adds a pass; setup runs right away to declare its resources, execute runs every frame.
+    void addPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute) {
+        Pass pass;
+        pass.name = name;
+        pass.execute = execute;
+        pass.hasSideEffect = false;
+        pass.framebuffer = 0;
+        pass.width = 0;
+        pass.height = 0;
+        pass.isScaled = false;
+        pass.clearMask = 0;
+        this->passes.push_back(pass);
+        this->isCompiled = false;
+
+        Builder builder(*this, (int)this->passes.size() - 1);
+        setup(builder);
+    }
+
+    // Removes every pass and resource; pooled textures and framebuffers are kept for reuse.
+    void clear() {
+        this->passes.clear();
+        this->resources.clear();
+        this->order.clear();
+        this->isCompiled = false;
+    }
+
+    // Orders and culls the passes and allocates their targets. Returns false if the graph is invalid.
+    bool compile() {
+        this->order.clear();
+        if (!this->orderPasses(this->findUsedPasses())) {
+            this->order.clear();
+            std::cout << "ERROR: Frame graph passes depend on each other in a cycle." << std::endl;
+            return false;
+        }
+
+        if (!this->allocateTargets()) {
+            this->order.clear();
+            return false;
+        }
+
+        this->isCompiled = true;
+        return true;
+    }
+
+    // Runs the passes of the compiled graph.
+    void execute() {
+        if (!this->isCompiled)
+            return;
+
+        for (int index : this->order) {
+            const Pass& pass = this->passes[index];
+
+            GLState::bindFramebuffer(pass.framebuffer);
+            if (pass.width > 0 && pass.height > 0) {
+                if (pass.isScaled)
+                    GLState::setViewport(0, 0, scaleSize(pass.width), scaleSize(pass.height));
+                else
+                    GLState::setViewport(0, 0, pass.width, pass.height);
+            }
+
+            if (pass.clearMask != 0) {
+                // Clearing honors the write masks
+                if (pass.clearMask & GL_COLOR_BUFFER_BIT)
+                    GLState::setColorMask(true);
+                if (pass.clearMask & GL_DEPTH_BUFFER_BIT)
+                    GLState::setDepthMask(true);
+                glClear(pass.clearMask);
+            }
+
+            pass.execute(*this);
+        }
+    }
+
+    // Sets the fraction (0 to 1] of the width and height of scaled targets drawn into from the next execute on.
+    void setResolutionScale(float scale) {
+        this->resolutionScale = std::min(std::max(scale, 0.0f), 1.0f);
+    }
+
+    // Returns the size of the part of a resource drawn into this frame; its full size unless it is scaled.
+    void getDrawnSize(FrameResource resource, GLsizei& width, GLsizei& height) const {
+        const Resource& target = this->resources[resource];
+        width = target.isScaled ? this->scaleSize(target.desc.width) : target.desc.width;
+        height = target.isScaled ? this->scaleSize(target.desc.height) : target.desc.height;
+    }
+
+    // Returns the texture holding a transient resource this frame (0 for window targets).
+    GLuint getTexture(FrameResource resource) const {
+        int pooledTexture = this->resources[resource].pooledTexture;
+        return pooledTexture >= 0 ? this->texturePool[pooledTexture].texture : 0;
+    }
+
+    // Returns the number of passes run per frame.
+    GLuint getPassCount() const {
+        return (GLuint)this->order.size();
+    }
+
+    // Returns the number of passes culled because nothing uses their results.
+    GLuint getCulledPassCount() const {
+        return this->isCompiled ? (GLuint)(this->passes.size() - this->order.size()) : 0;
+    }
+
+    // Returns the number of textures in the pool; aliased resources share one.
+    GLuint getPooledTextureCount() const {
+        return (GLuint)this->texturePool.size();
+    }
+};
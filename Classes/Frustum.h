@@ -0,0 +1,170 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// SSE2 is available on every x86-64 target; other targets use the scalar path
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HAS_SSE
+#endif
+
+/******** BOUNDING VOLUMES ********/
+// Axis-aligned bounding box.
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // Returns a box containing nothing, to be grown with expand().
+    static AABB empty() {
+        AABB box;
+        box.min = glm::vec3(FLT_MAX);
+        box.max = glm::vec3(-FLT_MAX);
+        return box;
+    }
+
+    // Grows the box to contain the point.
+    void expand(const glm::vec3& point) {
+        this->min = glm::min(this->min, point);
+        this->max = glm::max(this->max, point);
+    }
+
+    // Returns the box enclosing this box after a transformation.
+    AABB transform(const glm::mat4& matrix) const {
+        // Transform the center, then grow the extents by the absolute value of each axis (Arvo's method)
+        glm::vec3 center = (this->min + this->max) * 0.5f;
+        glm::vec3 extents = (this->max - this->min) * 0.5f;
+
+        glm::vec3 newCenter = glm::vec3(matrix * glm::vec4(center, 1.0f));
+        glm::vec3 newExtents = glm::abs(glm::vec3(matrix[0])) * extents.x +
+            glm::abs(glm::vec3(matrix[1])) * extents.y +
+            glm::abs(glm::vec3(matrix[2])) * extents.z;
+
+        AABB box;
+        box.min = newCenter - newExtents;
+        box.max = newCenter + newExtents;
+        return box;
+    }
+};
+
+// Bounding sphere.
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+
+    // Returns the sphere enclosing this sphere after a transformation.
+    BoundingSphere transform(const glm::mat4& matrix) const {
+        // The radius grows with the largest scale of the transformation
+        float maxScaleSq = glm::max(
+            glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+            glm::max(
+                glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+                glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))
+            )
+        );
+
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(matrix * glm::vec4(this->center, 1.0f));
+        sphere.radius = this->radius * std::sqrt(maxScaleSq);
+        return sphere;
+    }
+};
+
+/*
+    Frustum class implementation. Holds the six planes of a camera's view volume, extracted from its
+    projection and view matrices, and tests bounding volumes against them.
+
+    Works for perspective and orthographic cameras alike. Plane normals point into the frustum.
+ */
+class Frustum {
+private:
+    // Number of planes of a frustum
+    static const int PLANE_COUNT = 6;
+    // Planes (normal, distance) of the frustum: left, right, bottom, top, near, far
+    glm::vec4 planes[PLANE_COUNT];
+
+public:
+    // Instantiates a Frustum object that contains everything.
+    Frustum() {
+        for (int i = 0; i < PLANE_COUNT; i++)
+            this->planes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    // Instantiates a Frustum object from the camera's projection and view matrices.
+    Frustum(const glm::mat4& projection, const glm::mat4& view) {
+        // Gribb-Hartmann plane extraction; rows of the view-projection matrix
+        glm::mat4 viewProjection = glm::transpose(projection * view);
+        this->planes[0] = viewProjection[3] + viewProjection[0]; // left
+        this->planes[1] = viewProjection[3] - viewProjection[0]; // right
+        this->planes[2] = viewProjection[3] + viewProjection[1]; // bottom
+        this->planes[3] = viewProjection[3] - viewProjection[1]; // top
+        this->planes[4] = viewProjection[3] + viewProjection[2]; // near
+        this->planes[5] = viewProjection[3] - viewProjection[2]; // far
+
+        // Normalize the planes so that sphere radii can be compared to plane distances
+        for (int i = 0; i < PLANE_COUNT; i++)
+            this->planes[i] /= glm::length(glm::vec3(this->planes[i]));
+    }
+
+    // Returns true if the sphere is at least partially inside the frustum.
+    bool intersects(const BoundingSphere& sphere) const {
+        for (int i = 0; i < PLANE_COUNT; i++) {
+            if (glm::dot(glm::vec3(this->planes[i]), sphere.center) + this->planes[i].w < -sphere.radius)
+                return false;
+        }
+        return true;
+    }
+
+    // Returns true if the box is at least partially inside the frustum.
+    bool intersects(const AABB& box) const {
+        for (int i = 0; i < PLANE_COUNT; i++) {
+            // Test the corner furthest along the plane normal
+            glm::vec3 normal = glm::vec3(this->planes[i]);
+            glm::vec3 corner = glm::vec3(
+                normal.x >= 0.0f ? box.max.x : box.min.x,
+                normal.y >= 0.0f ? box.max.y : box.min.y,
+                normal.z >= 0.0f ? box.max.z : box.min.z
+            );
+            if (glm::dot(normal, corner) + this->planes[i].w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    // Tests a batch of spheres, four at a time where SSE is available. Sets visible[i] to 1 if sphere i
+    // is at least partially inside the frustum, otherwise to 0.
+    void intersects(const std::vector<BoundingSphere>& spheres, std::vector<unsigned char>& visible) const {
+        size_t count = spheres.size();
+        visible.resize(count);
+
+        size_t i = 0;
+#ifdef HAS_SSE
+        for (; i + 4 <= count; i += 4) {
+            // Load four spheres as separate x, y, z, and radius lanes
+            __m128 x = _mm_setr_ps(spheres[i].center.x, spheres[i + 1].center.x, spheres[i + 2].center.x, spheres[i + 3].center.x);
+            __m128 y = _mm_setr_ps(spheres[i].center.y, spheres[i + 1].center.y, spheres[i + 2].center.y, spheres[i + 3].center.y);
+            __m128 z = _mm_setr_ps(spheres[i].center.z, spheres[i + 1].center.z, spheres[i + 2].center.z, spheres[i + 3].center.z);
+            __m128 negRadius = _mm_setr_ps(-spheres[i].radius, -spheres[i + 1].radius, -spheres[i + 2].radius, -spheres[i + 3].radius);
+
+            // A lane stays set while its sphere is not fully behind any plane
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < PLANE_COUNT; p++) {
+                __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(this->planes[p].x)), _mm_mul_ps(y, _mm_set1_ps(this->planes[p].y))),
+                    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(this->planes[p].z)), _mm_set1_ps(this->planes[p].w))
+                );
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4; lane++)
+                visible[i + lane] = (mask >> lane) & 1;
+        }
+#endif
+        // Remaining spheres (or all of them without SSE)
+        for (; i < count; i++)
+            visible[i] = this->intersects(spheres[i]) ? 1 : 0;
+    }
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <glad/glad.h>
+
+/*
+    GL State class implementation. Shadows the OpenGL state changed while rendering (framebuffer, viewport,
+    program, VAO, texture bindings, blending, depth state, and color mask) and skips calls that would not
+    change anything.
+
+    Rendering code declares the state it needs through this class instead of restoring state after
+    itself. Code that changes the same state directly must call invalidate() afterwards.
+ */
+class GLState {
+private:
+    // Number of texture units being tracked
+    static const int TEXTURE_UNIT_COUNT = 16;
+    // Marks a tracked value as unknown, so the next change is always issued
+    static const GLuint UNKNOWN = 0xFFFFFFFF;
+
+    // The shadowed state
+    struct State {
+        GLuint framebuffer;
+        GLint viewport[4];
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeTextureUnit;
+        GLuint textures2D[TEXTURE_UNIT_COUNT];
+        GLuint texturesCubeMap[TEXTURE_UNIT_COUNT];
+        GLuint blend;
+        GLuint blendSrc;
+        GLuint blendDst;
+        GLuint depthTest;
+        GLuint depthMask;
+        GLuint depthFunc;
+        GLuint colorMask;
+        // Number of calls that were skipped
+        unsigned long long skippedCalls;
+    };
+
+    // Returns the shadowed state of the (single) OpenGL context.
+    static State& current() {
+        static State state = initialState();
+        return state;
+    }
+
+    // Returns a state where every value is unknown.
+    static State initialState() {
+        State state;
+        state.framebuffer = UNKNOWN;
+        for (int i = 0; i < 4; i++)
+            state.viewport[i] = -1;
+        state.program = UNKNOWN;
+        state.vertexArray = UNKNOWN;
+        state.activeTextureUnit = UNKNOWN;
+        for (int i = 0; i < TEXTURE_UNIT_COUNT; i++) {
+            state.textures2D[i] = UNKNOWN;
+            state.texturesCubeMap[i] = UNKNOWN;
+        }
+        state.blend = UNKNOWN;
+        state.blendSrc = UNKNOWN;
+        state.blendDst = UNKNOWN;
+        state.depthTest = UNKNOWN;
+        state.depthMask = UNKNOWN;
+        state.depthFunc = UNKNOWN;
+        state.colorMask = UNKNOWN;
+        state.skippedCalls = 0;
+        return state;
+    }
+
+    // Updates a shadowed value. Returns true if it changed, meaning the OpenGL call must be issued.
+    static bool change(GLuint& shadowed, GLuint value) {
+        if (shadowed == value) {
+            current().skippedCalls++;
+            return false;
+        }
+        shadowed = value;
+        return true;
+    }
+
+    // Enables or disables a capability if needed.
+    static void setCapability(GLuint& shadowed, GLenum capability, bool enable) {
+        if (!change(shadowed, enable ? GL_TRUE : GL_FALSE))
+            return;
+
+        if (enable)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+
+public:
+    // Forgets the shadowed state; the next change of every value is issued.
+    static void invalidate() {
+        unsigned long long skippedCalls = current().skippedCalls;
+        current() = initialState();
+        current().skippedCalls = skippedCalls;
+    }
+
+    // Binds a framebuffer for drawing and reading (0 for the window's framebuffer).
+    static void bindFramebuffer(GLuint framebuffer) {
+        if (change(current().framebuffer, framebuffer))
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    }
+
+    // Sets the viewport.
+    static void setViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+        State& state = current();
+        if (state.viewport[0] == x && state.viewport[1] == y && state.viewport[2] == width && state.viewport[3] == height) {
+            state.skippedCalls++;
+            return;
+        }
+
+        state.viewport[0] = x;
+        state.viewport[1] = y;
+        state.viewport[2] = width;
+        state.viewport[3] = height;
+        glViewport(x, y, width, height);
+    }
+
+    // Uses a shader program.
+    static void useProgram(GLuint program) {
+        if (change(current().program, program))
+            glUseProgram(program);
+    }
+
+    // Binds a vertex array object.
+    static void bindVertexArray(GLuint vertexArray) {
+        if (change(current().vertexArray, vertexArray))
+            glBindVertexArray(vertexArray);
+    }
+
+    // Selects the active texture unit (i.e., GL_TEXTURE0), which texture uploads and parameters apply to.
+    static void setActiveTexture(GLenum textureUnit) {
+        if (change(current().activeTextureUnit, textureUnit))
+            glActiveTexture(textureUnit);
+    }
+
+    // Binds a texture to a texture unit (i.e., GL_TEXTURE0). Only 2D and cube map textures are tracked.
+    static void bindTexture(GLenum textureUnit, GLenum target, GLuint texture) {
+        State& state = current();
+        GLuint unitIndex = textureUnit - GL_TEXTURE0;
+
+        GLuint* shadowed = NULL;
+        if (unitIndex < TEXTURE_UNIT_COUNT && target == GL_TEXTURE_2D)
+            shadowed = &state.textures2D[unitIndex];
+        else if (unitIndex < TEXTURE_UNIT_COUNT && target == GL_TEXTURE_CUBE_MAP)
+            shadowed = &state.texturesCubeMap[unitIndex];
+
+        if (shadowed != NULL && !change(*shadowed, texture))
+            return;
+
+        if (change(state.activeTextureUnit, textureUnit))
+            glActiveTexture(textureUnit);
+        glBindTexture(target, texture);
+    }
+
+    // Enables or disables blending.
+    static void setBlend(bool enable) {
+        setCapability(current().blend, GL_BLEND, enable);
+    }
+
+    // Sets the blending function.
+    static void setBlendFunc(GLenum src, GLenum dst) {
+        State& state = current();
+        if (state.blendSrc == src && state.blendDst == dst) {
+            state.skippedCalls++;
+            return;
+        }
+
+        state.blendSrc = src;
+        state.blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+
+    // Enables or disables depth testing.
+    static void setDepthTest(bool enable) {
+        setCapability(current().depthTest, GL_DEPTH_TEST, enable);
+    }
+
+    // Enables or disables writing into the depth buffer.
+    static void setDepthMask(bool enable) {
+        if (change(current().depthMask, enable ? GL_TRUE : GL_FALSE))
+            glDepthMask(enable ? GL_TRUE : GL_FALSE);
+    }
+
+    // Sets the depth comparison function.
+    static void setDepthFunc(GLenum func) {
+        if (change(current().depthFunc, func))
+            glDepthFunc(func);
+    }
+
+    // Enables or disables writing into every color channel.
+    static void setColorMask(bool enable) {
+        if (change(current().colorMask, enable ? GL_TRUE : GL_FALSE)) {
+            GLboolean mask = enable ? GL_TRUE : GL_FALSE;
+            glColorMask(mask, mask, mask, mask);
+        }
+    }
+
+    // Returns the number of OpenGL calls skipped so far because they would not change anything.
+    static unsigned long long getSkippedCallCount() {
+        return current().skippedCalls;
+    }
+};
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GLState.h"
+
+/******** GEOMETRY ARENA LAYOUT ********/
+// Every mesh is stored with the same vertex layout; attributes a mesh lacks are stored as zero
+// Offset of each attribute in a vertex (in floats)
+const int ARENA_POSITION_OFFSET = 0;
+const int ARENA_NORMAL_OFFSET = 3;
+const int ARENA_UV_OFFSET = 6;
+const int ARENA_TANGENT_OFFSET = 8;
+const int ARENA_BITANGENT_OFFSET = 11;
+// Number of floats of a vertex
+const int ARENA_VERTEX_SIZE = 14;
+// Attribute location of the per-instance object index; must match the layout qualifiers in main.vert
+const GLuint OBJECT_INDEX_LOCATION = 5;
+
+// Part of the geometry arena holding one mesh.
+struct ArenaMesh {
+    // ID of the mesh, unique among the meshes of the arena (0 if the mesh is empty)
+    GLuint id;
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+    GLuint vertexCount;
+};
+
+/*
+    Geometry Arena class implementation. Stores the meshes of every model in one vertex buffer and one
+    index buffer, drawn through a single VAO, so that draws of different meshes need no VAO changes
+    and can be submitted together with multi-draw indirect calls.
+
+    Meshes are given as triangle lists; identical vertices are merged and referenced through the index
+    buffer. A second VAO reads the same meshes from a tightly packed, position-only stream for
+    depth-only passes. Freed ranges are reused by later meshes, and the buffers grow when full.
+
+    Both VAOs also read the per-instance object index from one identity buffer (0, 1, 2, ...) shared by
+    every object batch; it is sized to the largest batch (see reserveObjects).
+ */
+class GeometryArena {
+private:
+    // Free ranges of a buffer, sorted by offset and never adjacent to each other
+    class RangeList {
+    private:
+        struct Range {
+            GLuint offset;
+            GLuint count;
+        };
+
+        std::vector<Range> ranges;
+
+    public:
+        // Takes the first free range that fits the count. Returns false if there is none.
+        bool allocate(GLuint count, GLuint& offset) {
+            for (size_t i = 0; i < this->ranges.size(); i++) {
+                Range& range = this->ranges[i];
+                if (range.count < count)
+                    continue;
+
+                offset = range.offset;
+                range.offset += count;
+                range.count -= count;
+                if (range.count == 0)
+                    this->ranges.erase(this->ranges.begin() + i);
+                return true;
+            }
+            return false;
+        }
+
+        // Returns a range, merging it with its free neighbors.
+        void free(GLuint offset, GLuint count) {
+            if (count == 0)
+                return;
+
+            size_t i = 0;
+            while (i < this->ranges.size() && this->ranges[i].offset < offset)
+                i++;
+
+            Range range;
+            range.offset = offset;
+            range.count = count;
+            this->ranges.insert(this->ranges.begin() + i, range);
+
+            // Merge with the next range, then with the previous one
+            if (i + 1 < this->ranges.size() && this->ranges[i].offset + this->ranges[i].count == this->ranges[i + 1].offset) {
+                this->ranges[i].count += this->ranges[i + 1].count;
+                this->ranges.erase(this->ranges.begin() + i + 1);
+            }
+            if (i > 0 && this->ranges[i - 1].offset + this->ranges[i - 1].count == this->ranges[i].offset) {
+                this->ranges[i - 1].count += this->ranges[i].count;
+                this->ranges.erase(this->ranges.begin() + i);
+            }
+        }
+    };
+
+    // The Vertex Array Object reading every attribute
+    GLuint VAO;
+    // The Vertex Array Object reading positions only
+    GLuint depthVAO;
+    // Vertices in the arena layout
+    GLuint vertexBuffer;
+    // Positions of the same vertices, tightly packed
+    GLuint positionBuffer;
+    // Indices of every mesh, relative to the mesh's base vertex
+    GLuint indexBuffer;
+    // Object indices (0, 1, 2, ...), read once per instance
+    GLuint objectIndexBuffer;
+
+    // Number of vertices and indices the buffers can hold
+    GLuint vertexCapacity;
+    GLuint indexCapacity;
+    // Number of objects the object index buffer can hold
+    GLuint objectIndexCapacity;
+    // Free parts of the buffers
+    RangeList freeVertices;
+    RangeList freeIndices;
+    // ID of the next allocated mesh
+    GLuint nextMeshID;
+
+    // Instantiates an empty Geometry Arena object; see shared().
+    GeometryArena() {
+        this->VAO = 0;
+        this->depthVAO = 0;
+        this->vertexBuffer = 0;
+        this->positionBuffer = 0;
+        this->indexBuffer = 0;
+        this->objectIndexBuffer = 0;
+        this->vertexCapacity = 0;
+        this->indexCapacity = 0;
+        this->objectIndexCapacity = 0;
+        this->nextMeshID = 1;
+    }
+
+    // Creates the VAOs and buffers on first use, once the OpenGL context exists.
+    void create() {
+        if (this->VAO != 0)
+            return;
+
+        glGenVertexArrays(1, &this->VAO);
+        glGenVertexArrays(1, &this->depthVAO);
+
+        // Attribute formats; the vertices are attached to binding 0 and the object indices to binding 1 by attachBuffers()
+        GLState::bindVertexArray(this->VAO);
+        const GLint sizes[5] = { 3, 3, 2, 3, 3 };
+        const GLuint offsets[5] = { ARENA_POSITION_OFFSET, ARENA_NORMAL_OFFSET, ARENA_UV_OFFSET, ARENA_TANGENT_OFFSET, ARENA_BITANGENT_OFFSET };
+        for (GLuint location = 0; location < 5; location++) {
+            glVertexAttribFormat(location, sizes[location], GL_FLOAT, GL_FALSE, offsets[location] * sizeof(GLfloat));
+            glVertexAttribBinding(location, 0);
+            glEnableVertexAttribArray(location);
+        }
+
+        GLState::bindVertexArray(this->depthVAO);
+        glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(0, 0);
+        glEnableVertexAttribArray(0);
+
+        // The object index advances once per instance instead of once per vertex
+        const GLuint vertexArrays[2] = { this->VAO, this->depthVAO };
+        for (GLuint vertexArray : vertexArrays) {
+            GLState::bindVertexArray(vertexArray);
+            glVertexAttribIFormat(OBJECT_INDEX_LOCATION, 1, GL_UNSIGNED_INT, 0);
+            glVertexAttribBinding(OBJECT_INDEX_LOCATION, 1);
+            glVertexBindingDivisor(1, 1);
+            glEnableVertexAttribArray(OBJECT_INDEX_LOCATION);
+        }
+
+        // The object index buffer keeps its name when it grows, so it is attached only once
+        glGenBuffers(1, &this->objectIndexBuffer);
+        this->attachBuffers();
+    }
+
+    // Attaches the current buffers to the VAOs.
+    void attachBuffers() {
+        GLState::bindVertexArray(this->VAO);
+        glBindVertexBuffer(0, this->vertexBuffer, 0, ARENA_VERTEX_SIZE * sizeof(GLfloat));
+        glBindVertexBuffer(1, this->objectIndexBuffer, 0, sizeof(GLuint));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+
+        GLState::bindVertexArray(this->depthVAO);
+        glBindVertexBuffer(0, this->positionBuffer, 0, 3 * sizeof(GLfloat));
+        glBindVertexBuffer(1, this->objectIndexBuffer, 0, sizeof(GLuint));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->indexBuffer);
+
+        GLState::bindVertexArray(0);
+    }
+
+    // Replaces a buffer with a larger one, keeping its contents.
+    static void growBuffer(GLuint& buffer, GLsizeiptr oldSize, GLsizeiptr newSize) {
+        GLuint newBuffer;
+        glGenBuffers(1, &newBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+
+        if (buffer != 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = newBuffer;
+    }
+
+    // Grows the vertex buffers to hold at least the given number of vertices more.
+    void growVertices(GLuint count) {
+        GLuint newCapacity = std::max(this->vertexCapacity * 2, this->vertexCapacity + count);
+        growBuffer(this->vertexBuffer, this->vertexCapacity * ARENA_VERTEX_SIZE * sizeof(GLfloat), newCapacity * ARENA_VERTEX_SIZE * sizeof(GLfloat));
+        growBuffer(this->positionBuffer, this->vertexCapacity * 3 * sizeof(GLfloat), newCapacity * 3 * sizeof(GLfloat));
+        this->freeVertices.free(this->vertexCapacity, newCapacity - this->vertexCapacity);
+        this->vertexCapacity = newCapacity;
+        this->attachBuffers();
+    }
+
+    // Grows the index buffer to hold at least the given number of indices more.
+    void growIndices(GLuint count) {
+        GLuint newCapacity = std::max(this->indexCapacity * 2, this->indexCapacity + count);
+        growBuffer(this->indexBuffer, this->indexCapacity * sizeof(GLuint), newCapacity * sizeof(GLuint));
+        this->freeIndices.free(this->indexCapacity, newCapacity - this->indexCapacity);
+        this->indexCapacity = newCapacity;
+        this->attachBuffers();
+    }
+
+public:
+    // Returns the arena shared by every model of the (single) OpenGL context.
+    static GeometryArena& shared() {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    // Stores a mesh given as a triangle list of vertices in the arena layout. Returns an empty mesh if there are no vertices.
+    ArenaMesh allocate(const std::vector<GLfloat>& vertexData) {
+        ArenaMesh mesh = ArenaMesh();
+        GLuint triangleVertexCount = (GLuint)(vertexData.size() / ARENA_VERTEX_SIZE);
+        if (triangleVertexCount == 0)
+            return mesh;
+
+        this->create();
+
+        // Merge identical vertices
+        std::vector<GLfloat> vertices;
+        std::vector<GLfloat> positions;
+        std::vector<GLuint> indices;
+        std::unordered_map<std::string, GLuint> vertexIndices;
+        indices.reserve(triangleVertexCount);
+        for (GLuint i = 0; i < triangleVertexCount; i++) {
+            const GLfloat* vertex = &vertexData[i * ARENA_VERTEX_SIZE];
+            std::string key((const char*)vertex, ARENA_VERTEX_SIZE * sizeof(GLfloat));
+
+            auto found = vertexIndices.find(key);
+            if (found != vertexIndices.end()) {
+                indices.push_back(found->second);
+                continue;
+            }
+
+            GLuint index = (GLuint)vertexIndices.size();
+            vertexIndices.emplace(key, index);
+            indices.push_back(index);
+            vertices.insert(vertices.end(), vertex, vertex + ARENA_VERTEX_SIZE);
+            positions.insert(positions.end(), vertex + ARENA_POSITION_OFFSET, vertex + ARENA_POSITION_OFFSET + 3);
+        }
+
+        mesh.vertexCount = (GLuint)vertexIndices.size();
+        mesh.indexCount = (GLuint)indices.size();
+
+        GLuint baseVertex = 0;
+        if (!this->freeVertices.allocate(mesh.vertexCount, baseVertex)) {
+            this->growVertices(mesh.vertexCount);
+            this->freeVertices.allocate(mesh.vertexCount, baseVertex);
+        }
+        if (!this->freeIndices.allocate(mesh.indexCount, mesh.firstIndex)) {
+            this->growIndices(mesh.indexCount);
+            this->freeIndices.allocate(mesh.indexCount, mesh.firstIndex);
+        }
+        mesh.baseVertex = (GLint)baseVertex;
+        mesh.id = this->nextMeshID++;
+
+        glBindBuffer(GL_ARRAY_BUFFER, this->vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, baseVertex * ARENA_VERTEX_SIZE * sizeof(GLfloat), vertices.size() * sizeof(GLfloat), vertices.data());
+        glBindBuffer(GL_ARRAY_BUFFER, this->positionBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, baseVertex * 3 * sizeof(GLfloat), positions.size() * sizeof(GLfloat), positions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        // The element array binding belongs to the VAO
+        GLState::bindVertexArray(this->VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, mesh.firstIndex * sizeof(GLuint), indices.size() * sizeof(GLuint), indices.data());
+        GLState::bindVertexArray(0);
+
+        return mesh;
+    }
+
+    // Releases the part of the arena holding a mesh, to be reused by later meshes.
+    void free(const ArenaMesh& mesh) {
+        if (mesh.id == 0)
+            return;
+
+        this->freeVertices.free((GLuint)mesh.baseVertex, mesh.vertexCount);
+        this->freeIndices.free(mesh.firstIndex, mesh.indexCount);
+    }
+
+    // Grows the object index buffer so that it can hold the given number of objects; each batch reserves the objects it draws.
+    void reserveObjects(GLuint count) {
+        this->create();
+        if (count <= this->objectIndexCapacity)
+            return;
+
+        this->objectIndexCapacity = std::max(count, this->objectIndexCapacity * 2);
+
+        std::vector<GLuint> indices(this->objectIndexCapacity);
+        for (GLuint i = 0; i < this->objectIndexCapacity; i++)
+            indices[i] = i;
+
+        glBindBuffer(GL_ARRAY_BUFFER, this->objectIndexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Returns the VAO reading every attribute of the meshes, with the index buffer bound.
+    GLuint getVertexArray() {
+        this->create();
+        return this->VAO;
+    }
+
+    // Returns the VAO reading only the positions of the meshes, with the index buffer bound.
+    GLuint getDepthVertexArray() {
+        this->create();
+        return this->depthVAO;
+    }
+
+    // Returns the number of vertices the arena can hold before growing.
+    GLuint getVertexCapacity() {
+        return this->vertexCapacity;
+    }
+
+    // Returns the number of indices the arena can hold before growing.
+    GLuint getIndexCapacity() {
+        return this->indexCapacity;
+    }
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "Frustum.h"
+#include "GLState.h"
+#include "SoftwareOcclusionCuller.h"
+#include "StreamBuffer.h"
+
+/*
+    Instance Culler class implementation. Culls the instances of instanced groups on the GPU with a compute
+    shader (see cull.comp), so that the CPU cost of a group does not depend on its number of instances.
+
+    Every group is tested against the camera's view volume, and against the depth pyramid of the software
+    occlusion culler when it holds occluders. Visible instances are compacted into the group's range of the
+    object attributes, and counted into the group's indirect draw commands with atomics, so the draw calls
+    consume the result without any readback.
+ */
+class InstanceCuller {
+public:
+    // An instanced group to be culled
+    struct Job {
+        // Shader storage buffer of the instances' attributes, relative to the parent
+        GLuint instanceBuffer;
+        GLuint instanceCount;
+        // Transformation of the parent every instance is placed by
+        glm::mat4 parentModel;
+        glm::mat3 parentNormalMatrix;
+        // Bounding sphere of the mesh in model space
+        BoundingSphere meshSphere;
+        // Index of the group's first object attributes
+        GLuint firstObject;
+        // Indirect commands drawing the group (-1 if the group has no depth command)
+        GLint command;
+        GLint depthCommand;
+    };
+
+private:
+    // Uniform handles of the culling shader
+    struct CullUniforms {
+        Uniform<glm::mat4> parentModel;
+        Uniform<glm::mat3> parentNormalMatrix;
+        Uniform<glm::vec4> meshSphere;
+        Uniform<int> instanceCount;
+        Uniform<int> firstObject;
+        Uniform<int> command;
+        Uniform<int> depthCommand;
+        Uniform<int> hiZ;
+        Uniform<bool> hasHiZ;
+
+        CullUniforms(const Shader& shader) {
+            this->parentModel = shader.getUniform<glm::mat4>("parentModel");
+            this->parentNormalMatrix = shader.getUniform<glm::mat3>("parentNormalMatrix");
+            this->meshSphere = shader.getUniform<glm::vec4>("meshSphere");
+            this->instanceCount = shader.getUniform<int>("instanceCount");
+            this->firstObject = shader.getUniform<int>("firstObject");
+            this->command = shader.getUniform<int>("command");
+            this->depthCommand = shader.getUniform<int>("depthCommand");
+            this->hiZ = shader.getUniform<int>("hiZ");
+            this->hasHiZ = shader.getUniform<bool>("hasHiZ");
+        }
+    };
+    // Cached uniform handles of the culling shader
+    UniformCache<CullUniforms> uniforms;
+
+    // Must match the local size in cull.comp
+    const GLuint WORK_GROUP_SIZE = 64;
+    // Texture unit of the depth pyramid
+    const GLenum HI_Z_UNIT = GL_TEXTURE15;
+
+    // Shader culling the instances
+    Shader* cullShader;
+    // Depth pyramid of the occluders, one mipmap level per pyramid level
+    GLuint hiZTexture;
+    // Flag to determine if the depth pyramid holds occluders of this frame
+    bool hasHiZ;
+    // Number of instances tested in the last cull
+    GLuint instanceCount;
+
+public:
+    // Instantiates an Instance Culler object culling with the given compute shader (see cull.comp).
+    InstanceCuller(Shader* cullShader) {
+        this->cullShader = cullShader;
+        this->hiZTexture = 0;
+        this->hasHiZ = false;
+        this->instanceCount = 0;
+    }
+
+    // Returns true if the culling shader finished building. Never blocks on the driver.
+    bool isReady() {
+        return this->cullShader->isReady();
+    }
+
+    // Uploads the depth pyramid of the occluders of this frame; NULL (or a culler without occluders) disables the occlusion test.
+    void setDepthPyramid(const SoftwareOcclusionCuller* softwareCuller) {
+        this->hasHiZ = softwareCuller != NULL && softwareCuller->hasOccluders();
+        if (!this->hasHiZ)
+            return;
+
+        bool isNew = this->hiZTexture == 0;
+        if (isNew)
+            glGenTextures(1, &this->hiZTexture);
+        GLState::bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, this->hiZTexture);
+        GLState::setActiveTexture(HI_Z_UNIT);
+
+        int width, height;
+        int levelCount = softwareCuller->getLevelCount();
+        if (isNew) {
+            softwareCuller->getLevel(0, width, height);
+            glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_R32F, width, height);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+        }
+
+        for (int level = 0; level < levelCount; level++) {
+            const std::vector<float>& depth = softwareCuller->getLevel(level, width, height);
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, GL_RED, GL_FLOAT, depth.data());
+        }
+    }
+
+    // Culls the jobs into the object attributes and the indirect commands of the frame; object and command
+    // indices of the jobs are relative to them. The commands of every job must start with an instance count
+    // of 0. Both are ready to be drawn from afterwards.
+    void cull(const std::vector<Job>& jobs, const StreamBuffer::Allocation& objects, const StreamBuffer::Allocation& commands) {
+        this->instanceCount = 0;
+        if (jobs.empty())
+            return;
+
+        this->cullShader->use();
+        const CullUniforms& uniforms = this->uniforms.get(*this->cullShader);
+        uniforms.hasHiZ.set(this->hasHiZ);
+        if (this->hasHiZ) {
+            GLState::bindTexture(HI_Z_UNIT, GL_TEXTURE_2D, this->hiZTexture);
+            uniforms.hiZ.set(HI_Z_UNIT - GL_TEXTURE0);
+        }
+
+        // Must match the bindings in cull.comp
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, objects.buffer, objects.offset, objects.size);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, commands.buffer, commands.offset, commands.size);
+
+        for (const Job& job : jobs) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, job.instanceBuffer);
+            uniforms.parentModel.set(job.parentModel);
+            uniforms.parentNormalMatrix.set(job.parentNormalMatrix);
+            uniforms.meshSphere.set(glm::vec4(job.meshSphere.center, job.meshSphere.radius));
+            uniforms.instanceCount.set((int)job.instanceCount);
+            uniforms.firstObject.set((int)job.firstObject);
+            uniforms.command.set(job.command);
+            uniforms.depthCommand.set(job.depthCommand);
+
+            glDispatchCompute((job.instanceCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+            this->instanceCount += job.instanceCount;
+        }
+
+        // The draw calls read the commands and the compacted attributes
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Returns the number of instances tested in the last cull.
+    GLuint getInstanceCount() {
+        return this->instanceCount;
+    }
+};
@@ -2,6 +2,11 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <cfloat>
+#include <cmath>
+
+#include "LightClusters.h"
+#include "UniformBuffer.h"
 
 /*
 	Abstract Light class implementation. Parent class for every light-related functionality.
@@ -22,9 +27,6 @@ protected:
 	float specularPhong;
 
 public:
-	// Virtual function for the binding of light attributes to the shader.
-	virtual void bindToShader(Shader shader) = 0;
-
 	// Returns the light color of this light.
 	glm::vec3 getLightColor() {
 		return glm::vec3(this->lightColor);
@@ -95,6 +97,10 @@ private:
 	float linear;
 	// Quadratic value of the point light
 	float quadratic;
+	// Attenuation below which the light is ignored; sets the radius of the light's cluster binning
+	const float attenuationCutoff = 1.0f / 256.0f;
+	// Flag to determine if the light's shadow is rendered into the shadow atlas (see ShadowMaps.h)
+	bool castsShadows;
 
 public:
 	// Initializes a Point Light object.
@@ -117,18 +123,34 @@ public:
 		this->specularPhong = specularPhong;
 		this->linear = linear;
 		this->quadratic = quadratic;
-	}
-
-	// Virtual function implementation. Binds the Point Light attributes to the specified shader.
-	void bindToShader(Shader shader) {
-		shader.setVec3("pointLight.position", this->position);
-		shader.setVec3("pointLight.lightColor", this->lightColor);
-		shader.setFloat("pointLight.ambientStr", this->ambientStr);
-		shader.setVec3("pointLight.ambientColor", this->ambientColor);
-		shader.setFloat("pointLight.specularStr", this->specularStr);
-		shader.setFloat("pointLight.specularPhong", this->specularPhong);
-		shader.setFloat("pointLight.linear", this->linear);
-		shader.setFloat("pointLight.quadratic", this->quadratic);
+		this->castsShadows = false;
+	}
+
+	// Submits the Point Light attributes to the light clusters of this frame.
+	void bindToClusters(LightClusters& clusters) {
+		PointLightBlock light;
+		light.position = this->position;
+		light.lightColor = this->lightColor;
+		light.ambientStr = this->ambientStr;
+		light.ambientColor = this->ambientColor;
+		light.specularStr = this->specularStr;
+		light.specularPhong = this->specularPhong;
+		light.linear = this->linear;
+		light.quadratic = this->quadratic;
+		light.radius = this->computeRadius();
+		light.castsShadows = this->castsShadows ? 1 : 0;
+		clusters.add(light);
+	}
+
+	// Returns the distance at which the attenuation of this point light falls to the cutoff.
+	float computeRadius() {
+		// Solve 1 / (1 + linear * d + quadratic * d^2) = cutoff for d
+		float c = 1.0f / this->attenuationCutoff - 1.0f;
+		if (this->quadratic > 0.0f)
+			return (-this->linear + std::sqrt(this->linear * this->linear + 4.0f * this->quadratic * c)) / (2.0f * this->quadratic);
+		if (this->linear > 0.0f)
+			return c / this->linear;
+		return FLT_MAX;
 	}
 
 	// Returns the linear value of this point light.
@@ -150,6 +172,11 @@ public:
 	void setQuadratic(float quadratic) {
 		this->quadratic = quadratic;
 	}
+
+	// Set if the shadow of this point light is rendered into the shadow atlas.
+	void setCastsShadows(bool castsShadows) {
+		this->castsShadows = castsShadows;
+	}
 };
 
 /*
@@ -175,13 +202,14 @@ public:
 		this->specularPhong = specularPhong;
 	}
 
-	// Virtual function implementation. Binds the Directional Light attributes to the specified shader.
-	void bindToShader(Shader shader) {
-		shader.setVec3("directionalLight.position", this->position);
-		shader.setVec3("directionalLight.lightColor", this->lightColor);
-		shader.setFloat("directionalLight.ambientStr", this->ambientStr);
-		shader.setVec3("directionalLight.ambientColor", this->ambientColor);
-		shader.setFloat("directionalLight.specularStr", this->specularStr);
-		shader.setFloat("directionalLight.specularPhong", this->specularPhong);
+	// Binds the Directional Light attributes to the lights uniform block.
+	void bindToBlock(LightsBlock& block) {
+		DirectionalLightBlock& light = block.directionalLight;
+		light.position = this->position;
+		light.lightColor = this->lightColor;
+		light.ambientStr = this->ambientStr;
+		light.ambientColor = this->ambientColor;
+		light.specularStr = this->specularStr;
+		light.specularPhong = this->specularPhong;
 	}
 };
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+
+/******** LIGHT CLUSTER BUFFER BINDINGS ********/
+// Must match the layout qualifiers in main.frag; bindings 0 to 2 are used by the object batch and cull.comp
+// Binding point of the point lights (shader storage buffer)
+const GLuint POINT_LIGHT_BUFFER_BINDING = 3;
+// Binding point of the light index range of every cluster (shader storage buffer)
+const GLuint CLUSTER_BUFFER_BINDING = 4;
+// Binding point of the light index list (shader storage buffer)
+const GLuint LIGHT_INDEX_BUFFER_BINDING = 5;
+
+/*
+    Light Clusters class implementation. Splits the camera's view volume into a grid of clusters (tiles
+    across the screen, exponentially spaced slices in depth) and bins the point lights of the frame into
+    the clusters their spheres of influence touch, so that a fragment only loops over the lights of its
+    own cluster (see main.frag). Lighting cost scales with the number of lights near a fragment rather
+    than with the total number of lights.
+
+    Lights are binned on the CPU every frame. The lights, the light index range of every cluster, and
+    the light index list are written to the stream buffer; the grid layout is a uniform block.
+
+    In brute-force mode every light is binned into every cluster, so that each fragment loops over every
+    light; the frames must match the clustered ones, which checks the binning.
+ */
+class LightClusters {
+private:
+    // Clusters of the grid a light touches, inclusive
+    struct ClusterRange {
+        int min[3];
+        int max[3];
+    };
+
+    // Number of clusters across the screen and in depth
+    const int GRID_WIDTH = 16;
+    const int GRID_HEIGHT = 9;
+    const int GRID_DEPTH = 24;
+    // Smallest depth the first slice starts at; keeps the slices finite for cameras with a zero near plane
+    const float MIN_NEAR = 0.01f;
+
+    // Flag to determine if every light is binned into every cluster
+    bool isBruteForce;
+
+    // Point lights submitted for this frame
+    std::vector<PointLightBlock> lights;
+    // Clusters touched by each light of this frame
+    std::vector<ClusterRange> ranges;
+    // Light index range of every cluster (offset, count)
+    std::vector<glm::uvec2> clusters;
+    // Indices of the lights of every cluster, one cluster after another
+    std::vector<GLuint> lightIndices;
+
+    // Layout of the grid for the camera of this frame
+    ClusterBlock clusterBlock;
+    UniformBuffer<ClusterBlock> clusterBuffer;
+
+    // Returns the slice of a view-space depth, clamped to the grid.
+    int computeSlice(float depth) {
+        float slice = std::floor(std::log(std::max(depth, this->clusterBlock.zNear)) * this->clusterBlock.sliceScale - this->clusterBlock.sliceBias);
+        return (int)std::min(std::max(slice, 0.0f), (float)(GRID_DEPTH - 1));
+    }
+
+    // Returns the column (or row) of a normalized device coordinate, clamped to the grid.
+    static int computeTile(float ndc, int tileCount) {
+        int tile = (int)std::floor((ndc * 0.5f + 0.5f) * tileCount);
+        return std::min(std::max(tile, 0), tileCount - 1);
+    }
+
+    // Finds the clusters touched by the light's sphere of influence. Returns false if it is outside the view volume.
+    bool computeRange(const PointLightBlock& light, const CameraBlock& camera, ClusterRange& range) {
+        glm::vec3 center = glm::vec3(camera.view * glm::vec4(light.position, 1.0f));
+        float depth = -center.z;
+        float radius = light.radius;
+        if (depth + radius < this->clusterBlock.zNear || depth - radius > this->clusterBlock.zFar)
+            return false;
+
+        range.min[2] = this->computeSlice(depth - radius);
+        range.max[2] = this->computeSlice(depth + radius);
+
+        // A sphere reaching the camera may cover the whole screen
+        range.min[0] = range.min[1] = 0;
+        range.max[0] = GRID_WIDTH - 1;
+        range.max[1] = GRID_HEIGHT - 1;
+        if (depth - radius <= 0.0f)
+            return true;
+
+        // Project the corners of the box around the sphere
+        glm::vec2 minNDC = glm::vec2(FLT_MAX);
+        glm::vec2 maxNDC = glm::vec2(-FLT_MAX);
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 offset = glm::vec3(
+                (corner & 1) ? radius : -radius,
+                (corner & 2) ? radius : -radius,
+                (corner & 4) ? radius : -radius
+            );
+            glm::vec4 clip = camera.projection * glm::vec4(center + offset, 1.0f);
+            glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            minNDC = glm::min(minNDC, ndc);
+            maxNDC = glm::max(maxNDC, ndc);
+        }
+
+        if (maxNDC.x < -1.0f || maxNDC.y < -1.0f || minNDC.x > 1.0f || minNDC.y > 1.0f)
+            return false;
+
+        range.min[0] = computeTile(minNDC.x, GRID_WIDTH);
+        range.min[1] = computeTile(minNDC.y, GRID_HEIGHT);
+        range.max[0] = computeTile(maxNDC.x, GRID_WIDTH);
+        range.max[1] = computeTile(maxNDC.y, GRID_HEIGHT);
+        return true;
+    }
+
+    // Writes the elements to the stream buffer and binds them to the binding point. Never binds an empty range.
+    template <typename T>
+    static void streamToBinding(const std::vector<T>& elements, GLuint bindingPoint) {
+        StreamBuffer::Allocation allocation = StreamBuffer::shared().allocate(std::max<size_t>(elements.size(), 1) * sizeof(T));
+        if (allocation.data == NULL)
+            return;
+
+        std::copy(elements.begin(), elements.end(), (T*)allocation.data);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, bindingPoint, allocation.buffer, allocation.offset, allocation.size);
+    }
+
+public:
+    // Instantiates a Light Clusters object.
+    LightClusters() : clusterBuffer(CLUSTER_BLOCK_BINDING) {
+        this->clusterBlock = ClusterBlock();
+        this->isBruteForce = false;
+    }
+
+    // Removes the point lights submitted for the previous frame.
+    void begin() {
+        this->lights.clear();
+    }
+
+    // Submits a point light for this frame.
+    void add(const PointLightBlock& light) {
+        this->lights.push_back(light);
+    }
+
+    // Bins the submitted point lights into the clusters of the camera, and binds the result for the model shader.
+    void build(const CameraBlock& camera) {
+        // Depth range of the slices; the near plane is recovered from the projection (perspective or orthographic)
+        glm::vec4 nearPoint = glm::inverse(camera.projection) * glm::vec4(0.0f, 0.0f, -1.0f, 1.0f);
+        float zNear = std::max(-nearPoint.z / nearPoint.w, MIN_NEAR);
+        float zFar = std::max(camera.zFar, zNear * 2.0f);
+        float logDepthRange = std::log(zFar / zNear);
+
+        this->clusterBlock.gridSize = glm::uvec4(GRID_WIDTH, GRID_HEIGHT, GRID_DEPTH, 0);
+        this->clusterBlock.zNear = zNear;
+        this->clusterBlock.zFar = zFar;
+        this->clusterBlock.sliceScale = GRID_DEPTH / logDepthRange;
+        this->clusterBlock.sliceBias = GRID_DEPTH * std::log(zNear) / logDepthRange;
+        this->clusterBuffer.update(this->clusterBlock);
+
+        // Count the lights of every cluster
+        this->clusters.assign(GRID_WIDTH * GRID_HEIGHT * GRID_DEPTH, glm::uvec2(0));
+        this->ranges.resize(this->lights.size());
+        for (size_t i = 0; i < this->lights.size(); i++) {
+            ClusterRange& range = this->ranges[i];
+            if (this->isBruteForce) {
+                range.min[0] = range.min[1] = range.min[2] = 0;
+                range.max[0] = GRID_WIDTH - 1;
+                range.max[1] = GRID_HEIGHT - 1;
+                range.max[2] = GRID_DEPTH - 1;
+            }
+            else if (!this->computeRange(this->lights[i], camera, range)) {
+                range.min[2] = 0;
+                range.max[2] = -1;
+                continue;
+            }
+
+            for (int z = range.min[2]; z <= range.max[2]; z++)
+                for (int y = range.min[1]; y <= range.max[1]; y++)
+                    for (int x = range.min[0]; x <= range.max[0]; x++)
+                        this->clusters[x + GRID_WIDTH * (y + GRID_HEIGHT * z)].y++;
+        }
+
+        // Turn the counts into offsets, then fill the list; counts are rebuilt while filling
+        GLuint offset = 0;
+        for (glm::uvec2& cluster : this->clusters) {
+            cluster.x = offset;
+            offset += cluster.y;
+            cluster.y = 0;
+        }
+        this->lightIndices.resize(offset);
+        for (size_t i = 0; i < this->lights.size(); i++) {
+            const ClusterRange& range = this->ranges[i];
+            for (int z = range.min[2]; z <= range.max[2]; z++) {
+                for (int y = range.min[1]; y <= range.max[1]; y++) {
+                    for (int x = range.min[0]; x <= range.max[0]; x++) {
+                        glm::uvec2& cluster = this->clusters[x + GRID_WIDTH * (y + GRID_HEIGHT * z)];
+                        this->lightIndices[cluster.x + cluster.y++] = (GLuint)i;
+                    }
+                }
+            }
+        }
+
+        streamToBinding(this->lights, POINT_LIGHT_BUFFER_BINDING);
+        streamToBinding(this->clusters, CLUSTER_BUFFER_BINDING);
+        streamToBinding(this->lightIndices, LIGHT_INDEX_BUFFER_BINDING);
+    }
+
+    // Toggles between binning the lights into the clusters they touch and into every cluster.
+    void toggleBruteForce(bool isBruteForce) {
+        this->isBruteForce = isBruteForce;
+    }
+
+    // Returns true if every light is binned into every cluster.
+    bool isBruteForceUsed() {
+        return this->isBruteForce;
+    }
+
+    // Returns the number of point lights submitted for this frame.
+    GLuint getLightCount() {
+        return (GLuint)this->lights.size();
+    }
+
+    // Returns the number of light indices of the clusters built last, summed over every cluster.
+    GLuint getLightIndexCount() {
+        return (GLuint)this->lightIndices.size();
+    }
+};
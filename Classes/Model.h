@@ -1,10 +1,45 @@
 #pragma once
 
+/******** MODEL INSTANCES ********/
+// Flags of a model instance
+// The instance is not drawn
+const GLuint MODEL_INSTANCE_HIDDEN = 1u << 0;
+
+// Placement of one copy of a model drawn in instance mode, relative to the model's own transformation.
+struct ModelInstance {
+    glm::vec3 position;
+    glm::vec3 rotation;
+    glm::vec3 scale;
+    glm::vec3 color;
+    GLuint flags;
+};
+
 /*
     3D Model class implementation. Holds every model-related functionality.
+
+    In instance mode, the model draws many copies of its mesh (such as a school of creatures) with a
+    single instanced draw call. Each copy is placed relative to the model's own position, rotation,
+    and scale, so moving the model moves all of them.
  */
 class Model {
 private:
+    // CPU-side contents of a loaded .obj file
+    struct ObjData {
+        // The vertex data of the .obj file
+        std::vector<GLfloat> fullVertexData;
+        // Flag to determine if the .obj file has normal coordinates
+        bool hasNormals = true;
+        // Flag to determine if the .obj file has texture coordinates
+        bool hasTexCoords = true;
+    };
+
+    // Path to the .obj file of this model
+    std::string objPath;
+    // Paths to the textures of this model
+    std::vector<std::string> texturePaths;
+    // Path to the normal map of this model
+    std::string normalMapPath;
+
     // The data of the .obj file provided for this model
     std::vector<GLfloat> fullVertexData;
     // Position of the model
@@ -26,21 +61,42 @@ private:
     bool hasTexture;
     // Flag for showing the model color or not
     bool showColor;
+    // Flag to determine if the texture has pixels cut out by their alpha
+    bool hasAlphaCutout;
 
     // List that contains the textures of this model
     std::vector<Texture> textures;
     // List that contains the normals of this model
     Texture normalMap;
 
-    // The Vertex Array Object of this model
-    GLuint VAO;
-    // The Vertex Buffer Object of this model
-    GLuint VBO;
+    // The part of the geometry arena holding this model's mesh
+    ArenaMesh mesh;
     // The length of the data of this model
     int dataLen;
+    // Bounding box of the mesh in model space
+    AABB localBounds;
+    // Bounding sphere of the mesh in model space
+    BoundingSphere localSphere;
+    // ID under which the model is tested for occlusion (0 if it is not tested)
+    GLuint occlusionID;
+    // Flag to determine if the model hides the objects behind it from software occlusion culling
+    bool isOccluder;
+    // Model-space positions of the mesh (triangle list); only kept for occluders
+    std::vector<glm::vec3> occluderVertices;
+
+    // Flag to determine if the model draws its instances instead of a single copy
+    bool isInstanced;
+    // Attributes of the visible instances, relative to the model's transformation
+    std::vector<ObjectData> instanceData;
+    // Bounding box of the visible instances, relative to the model's transformation
+    AABB instanceBounds;
+    // Bounding sphere of the visible instances, relative to the model's transformation
+    BoundingSphere instanceSphere;
+    // Shader storage buffer holding the attributes of the visible instances, for culling them on the GPU
+    GLuint instanceBuffer;
 
     // Limit on the textures to be loaded
-    const int TEXT_LIMIT = 1;
+    static const int TEXT_LIMIT = 1;
     // Offset value for textures and normal maps
     const int TEXT_OFFSET = 9;
     // Size of vertex components (XYZ)
@@ -55,9 +111,11 @@ private:
     const int BITAN_SIZE = 3;
     // Location of Normal Map
     const int NORM_MAP_LOC = 9;
+    // Texture unit of Normal Map
+    const GLuint NORM_MAP_UNIT = GL_TEXTURE9;
 
-    // Loads the data inside the .obj file provided. 
-    void loadObjData(std::string path) {
+    // Loads the data inside the .obj file provided. Returns true if the file was loaded successfully.
+    bool loadObjData(std::string path, ObjData& objData) {
         std::cout << "Loading model data from: " << path << std::endl;
 
         // Will contain the mesh's shapes
@@ -86,13 +144,13 @@ private:
 
             // Check if the 3D model has normals
             if (attributes.normals.size() <= 0) {
-                this->hasNormals = false;
+                objData.hasNormals = false;
                 std::cout << "WARNING: No normals data was found." << std::endl;
             }
 
             // Check if the 3D model has texture coordinates
             if (attributes.texcoords.size() <= 0) {
-                this->hasTexCoords = false;
+                objData.hasTexCoords = false;
                 std::cout << "WARNING: No texcoords data was found." << std::endl;
             }
 
@@ -178,48 +236,48 @@ private:
                     int vertexIndex = vData.vertex_index * 3;
 
                     // X
-                    fullVertexData.push_back(
+                    objData.fullVertexData.push_back(
                         attributes.vertices[vertexIndex]
                     );
                     // Y
-                    fullVertexData.push_back(
+                    objData.fullVertexData.push_back(
                         attributes.vertices[vertexIndex + 1]
                     );
                     // Z
-                    fullVertexData.push_back(
+                    objData.fullVertexData.push_back(
                         attributes.vertices[vertexIndex + 2]
                     );
 
                     // If the model has normals
-                    if (hasNormals) {
+                    if (objData.hasNormals) {
                         // Get offset for normals
                         int normalIndex = vData.normal_index * 3;
 
                         // Normal index 1
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             attributes.normals[normalIndex]
                         );
                         // Normal index 2
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             attributes.normals[normalIndex + 1]
                         );
                         // Normal index 3
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             attributes.normals[normalIndex + 2]
                         );
                     }
 
                     // If the model has texture coordinates
-                    if (hasTexCoords) {
+                    if (objData.hasTexCoords) {
                         // Get offset for UV
                         int uvIndex = vData.texcoord_index * 2;
 
                         // U
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             attributes.texcoords[uvIndex]
                         );
                         // V
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             attributes.texcoords[uvIndex + 1]
                         );
                     }
@@ -227,24 +285,24 @@ private:
                     // If the model has normal mapping
                     if (hasNormalMapping) {
                         // Tangents for normal map
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             tangents[i].x
                         );
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             tangents[i].y
                         );
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             tangents[i].z
                         );
 
                         // Bitangents for normal map
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             bitangents[i].x
                         );
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             bitangents[i].y
                         );
-                        fullVertexData.push_back(
+                        objData.fullVertexData.push_back(
                             bitangents[i].z
                         );
                     }
@@ -257,6 +315,92 @@ private:
             // Show warning and error messages
             std::cout << warning << " | " << error << std::endl;
         }
+
+        return isModelLoaded;
+    }
+
+    // Returns true if a decoded image has pixels that the model shader discards (alpha below 0.1).
+    // Filtering only averages texels, so images without such texels never need the alpha test.
+    static bool needsAlphaCutout(const unsigned char* tex_bytes, int imgWidth, int imgHeight, int colorChannels) {
+        if (colorChannels != 4)
+            return false;
+
+        for (size_t i = 3; i < (size_t)imgWidth * imgHeight * 4; i += 4) {
+            if (tex_bytes[i] < 26)
+                return true;
+        }
+        return false;
+    }
+
+    // Creates a texture from a decoded image and returns its unique ID.
+    GLuint createTexture(unsigned char* tex_bytes, int imgWidth, int imgHeight, int colorChannels, GLuint textureUnit) {
+        // Prepare texture
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glActiveTexture(textureUnit);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        // If 3-channel texture (i.e., JPG)
+        if (colorChannels == 3) {
+            std::cout << "3-channel image detected!" << std::endl;
+            glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                GL_RGB,
+                imgWidth,
+                imgHeight,
+                0,
+                GL_RGB,
+                GL_UNSIGNED_BYTE,
+                tex_bytes
+            );
+        }
+        // If 4-channel texture (i.e., PNG)
+        else {
+            std::cout << "4-channel image detected!" << std::endl;
+            glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                GL_RGBA,
+                imgWidth,
+                imgHeight,
+                0,
+                GL_RGBA,
+                GL_UNSIGNED_BYTE,
+                tex_bytes
+            );
+        }
+
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return textureID;
+    }
+
+    // Creates a normal mapping texture from a decoded image and returns its unique ID.
+    GLuint createNormalMap(unsigned char* norm_bytes, int imgWidth, int imgHeight) {
+        // Prepare normal mapping
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glActiveTexture(NORM_MAP_UNIT);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        // Set the parameters to be the same as the diffuse color
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            GL_RGB,
+            imgWidth,
+            imgHeight,
+            0,
+            GL_RGB,
+            GL_UNSIGNED_BYTE,
+            norm_bytes
+        );
+
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return textureID;
     }
 
     // Loads the textures of this model given a list of file paths.
@@ -289,48 +433,14 @@ private:
                 std::cout << "Loaded successfully!" << std::endl;
                 std::cout << "Binding texture..." << std::endl;
 
-                // Prepare texture
-                GLuint textureID;
                 // texture starts at GL_TEXTURE0 upwards
                 GLuint textureUnit = GL_TEXTURE0 + i;
-                glGenTextures(1, &textureID);
-                glActiveTexture(textureUnit);
-                glBindTexture(GL_TEXTURE_2D, textureID);
-
-                // If 3-channel texture (i.e., JPG)
-                if (colorChannels == 3) {
-                    std::cout << "3-channel image detected!" << std::endl;
-                    glTexImage2D(
-                        GL_TEXTURE_2D,
-                        0,
-                        GL_RGB,
-                        imgWidth,
-                        imgHeight,
-                        0,
-                        GL_RGB,
-                        GL_UNSIGNED_BYTE,
-                        tex_bytes
-                    );
-                }
-                // If 4-channel texture (i.e., PNG)
-                else {
-                    std::cout << "4-channel image detected!" << std::endl;
-                    glTexImage2D(
-                        GL_TEXTURE_2D,
-                        0,
-                        GL_RGBA,
-                        imgWidth,
-                        imgHeight,
-                        0,
-                        GL_RGBA,
-                        GL_UNSIGNED_BYTE,
-                        tex_bytes
-                    );
-                }
+                GLuint textureID = createTexture(tex_bytes, imgWidth, imgHeight, colorChannels, textureUnit);
+                if (i == 0)
+                    this->hasAlphaCutout = needsAlphaCutout(tex_bytes, imgWidth, imgHeight, colorChannels);
 
                 // Append the texture onto the model's list
                 textures.push_back(Texture(textureID, textureUnit));
-                glGenerateMipmap(GL_TEXTURE_2D);
                 stbi_image_free(tex_bytes);
 
                 std::cout << "Texture bound successfully!" << std::endl;
@@ -363,33 +473,9 @@ private:
             std::cout << "Loaded successfully!" << std::endl;
             std::cout << "Binding normal mapping..." << std::endl;
 
-            // Prepare normal mapping
-            GLuint textureID;
-            // normal mapping starts at GL_TEXTURE9 upwards (to avoid conflict with texture)
-            GLuint textureUnit = GL_TEXTURE9;
-            glGenTextures(1, &textureID);
-            glActiveTexture(textureUnit);
-            glBindTexture(GL_TEXTURE_2D, textureID);
-
-            // Set the parameters to be the same as the diffuse color
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-            glTexImage2D(
-                GL_TEXTURE_2D,
-                0,
-                GL_RGB,
-                imgWidth,
-                imgHeight,
-                0,
-                GL_RGB,
-                GL_UNSIGNED_BYTE,
-                norm_bytes
-            );
-
             // Instantiate normal mapping as Texture
-            this->normalMap = Texture(textureID, textureUnit);
-            glGenerateMipmap(GL_TEXTURE_2D);
+            // normal mapping uses GL_TEXTURE9 (to avoid conflict with texture)
+            this->normalMap = Texture(createNormalMap(norm_bytes, imgWidth, imgHeight), NORM_MAP_UNIT);
             stbi_image_free(norm_bytes);
 
             std::cout << "Normal mapping bound successfully!" << std::endl;
@@ -399,12 +485,74 @@ private:
         }
     }
 
-    // Binds this model's data onto its VAO and VBO.
+    // Returns a new ID for occlusion testing, unique among models.
+    static GLuint generateOcclusionID() {
+        static GLuint nextID = 1;
+        return nextID++;
+    }
+
+    // Computes the model-space bounding box and sphere of the mesh from its vertex positions.
+    void computeBounds() {
+        this->localBounds.min = glm::vec3(0.0f);
+        this->localBounds.max = glm::vec3(0.0f);
+        this->localSphere.center = glm::vec3(0.0f);
+        this->localSphere.radius = 0.0f;
+
+        if (this->fullVertexData.empty())
+            return;
+
+        // The position is the first attribute of every vertex
+        this->localBounds = AABB::empty();
+        for (size_t i = 0; i + VERT_SIZE <= this->fullVertexData.size(); i += this->dataLen)
+            this->localBounds.expand(glm::vec3(this->fullVertexData[i], this->fullVertexData[i + 1], this->fullVertexData[i + 2]));
+
+        // Center the sphere on the box, then grow it to reach the furthest vertex
+        this->localSphere.center = (this->localBounds.min + this->localBounds.max) * 0.5f;
+        float maxDistanceSq = 0.0f;
+        for (size_t i = 0; i + VERT_SIZE <= this->fullVertexData.size(); i += this->dataLen) {
+            glm::vec3 vertex = glm::vec3(this->fullVertexData[i], this->fullVertexData[i + 1], this->fullVertexData[i + 2]);
+            glm::vec3 offset = vertex - this->localSphere.center;
+            maxDistanceSq = std::max(maxDistanceSq, glm::dot(offset, offset));
+        }
+        this->localSphere.radius = std::sqrt(maxDistanceSq);
+    }
+
+    // Computes the bounding box and sphere of the visible instances from their transformations and the mesh's bounds.
+    void computeInstanceBounds() {
+        this->instanceBounds = AABB::empty();
+
+        std::vector<BoundingSphere> spheres;
+        for (const ObjectData& data : this->instanceData) {
+            AABB bounds = this->localBounds.transform(data.model);
+            this->instanceBounds.expand(bounds.min);
+            this->instanceBounds.expand(bounds.max);
+            spheres.push_back(this->localSphere.transform(data.model));
+        }
+
+        // Center the sphere on the box, then grow it to reach the furthest instance's sphere
+        this->instanceSphere.center = this->instanceData.empty() ? glm::vec3(0.0f) : (this->instanceBounds.min + this->instanceBounds.max) * 0.5f;
+        this->instanceSphere.radius = 0.0f;
+        for (const BoundingSphere& sphere : spheres)
+            this->instanceSphere.radius = std::max(this->instanceSphere.radius, glm::distance(this->instanceSphere.center, sphere.center) + sphere.radius);
+    }
+
+    // Copies the vertex positions of the mesh for software occlusion culling, or frees them if the model is no occluder.
+    void extractOccluderVertices() {
+        this->occluderVertices.clear();
+        if (!this->isOccluder) {
+            this->occluderVertices.shrink_to_fit();
+            return;
+        }
+
+        for (size_t i = 0; i + VERT_SIZE <= this->fullVertexData.size(); i += this->dataLen)
+            this->occluderVertices.push_back(glm::vec3(this->fullVertexData[i], this->fullVertexData[i + 1], this->fullVertexData[i + 2]));
+    }
+
+    // Stores this model's data in the geometry arena, converted to the arena's vertex layout.
     void bindObjData() {
         // Initialize data length and pointer offset for buffers
         // To accommodate models without normals, texcoords, and/or normal mapping
         this->dataLen = VERT_SIZE;
-        int ptrOffset = VERT_SIZE;
         if (hasNormals)
             this->dataLen += NORM_SIZE;
         if (hasTexCoords)
@@ -412,112 +560,43 @@ private:
         if (hasNormalMapping)
             this->dataLen += TAN_SIZE + BITAN_SIZE;
 
-        // Generate VAO
-        glGenVertexArrays(1, &this->VAO);
-        // Generate VBO
-        glGenBuffers(1, &this->VBO);
-
-        // Bind the 3D model's data onto the created VBO
-        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-        glBufferData(
-            GL_ARRAY_BUFFER,
-            sizeof(GL_FLOAT) * this->fullVertexData.size(),
-            this->fullVertexData.data(),
-            GL_STATIC_DRAW
-        );
-
-        // Bind the 3D model's data onto the VAO
-        glBindVertexArray(this->VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-        glVertexAttribPointer(
-            0,
-            VERT_SIZE,
-            GL_FLOAT,
-            GL_FALSE,
-            this->dataLen * sizeof(GL_FLOAT),
-            (void*)0
-        );
-
-        // Enable index 0 (vertex positions)
-        glEnableVertexAttribArray(0);
-
-        // If the 3D Model has normals
-        if (hasNormals) {
-            // Tell OpenGL to use the normals points
-            GLintptr normPtr = ptrOffset * sizeof(GLfloat);
-
-            glVertexAttribPointer(
-                1,
-                NORM_SIZE,
-                GL_FLOAT,
-                GL_FALSE,
-                this->dataLen * sizeof(GL_FLOAT),
-                (void*)normPtr
-            );
-
-            // Enable index 1 (normals)
-            glEnableVertexAttribArray(1);
-
-            // Adjust pointer offset
-            ptrOffset += NORM_SIZE;
-        }
-
-        // If the 3D Model has texture coordinates
-        if (hasTexCoords) {
-            // Tell OpenGL to use the next 2 data points as U and V
-            GLintptr uvPtr = ptrOffset * sizeof(GLfloat);
-
-            glVertexAttribPointer(
-                2,
-                UV_SIZE,
-                GL_FLOAT,
-                GL_FALSE,
-                this->dataLen * sizeof(GL_FLOAT),
-                (void*)uvPtr
-            );
-
-            // Enable index 2 (textures)
-            glEnableVertexAttribArray(2);
-
-            // Adjust pointer offset
-            ptrOffset += UV_SIZE;
-        }
-
-        // If the 3D Model has normal mapping
-        if (hasNormalMapping) {
-            // Tell OpenGL to use the next 3 data points for the tangent
-            GLintptr tangentPtr = ptrOffset * sizeof(float);
-            // Tell OpenGL to use the next 3 data points for the bitangent
-            GLintptr bitangentPtr = (ptrOffset + TAN_SIZE) * sizeof(float);
-
-            glVertexAttribPointer(
-                3,
-                TAN_SIZE,
-                GL_FLOAT,
-                GL_FALSE,
-                this->dataLen * sizeof(GL_FLOAT),
-                (void*)tangentPtr
-            );
+        // The bounding volumes and occluder follow the mesh, including when it is hot-reloaded
+        this->computeBounds();
+        this->extractOccluderVertices();
+        if (this->isInstanced)
+            this->computeInstanceBounds();
+
+        // Copy every attribute to its place in the arena layout; missing attributes stay zero
+        size_t vertexCount = this->fullVertexData.size() / this->dataLen;
+        std::vector<GLfloat> arenaVertexData(vertexCount * ARENA_VERTEX_SIZE, 0.0f);
+        for (size_t i = 0; i < vertexCount; i++) {
+            const GLfloat* vertex = &this->fullVertexData[i * this->dataLen];
+            GLfloat* arenaVertex = &arenaVertexData[i * ARENA_VERTEX_SIZE];
+            int ptrOffset = 0;
+
+            std::copy(vertex, vertex + VERT_SIZE, arenaVertex + ARENA_POSITION_OFFSET);
+            ptrOffset += VERT_SIZE;
+
+            // If the 3D Model has normals
+            if (hasNormals) {
+                std::copy(vertex + ptrOffset, vertex + ptrOffset + NORM_SIZE, arenaVertex + ARENA_NORMAL_OFFSET);
+                ptrOffset += NORM_SIZE;
+            }
 
-            glVertexAttribPointer(
-                4,
-                BITAN_SIZE,
-                GL_FLOAT,
-                GL_FALSE,
-                this->dataLen * sizeof(GL_FLOAT),
-                (void*)bitangentPtr
-            );
+            // If the 3D Model has texture coordinates
+            if (hasTexCoords) {
+                std::copy(vertex + ptrOffset, vertex + ptrOffset + UV_SIZE, arenaVertex + ARENA_UV_OFFSET);
+                ptrOffset += UV_SIZE;
+            }
 
-            // Enable index 3 (tangents)
-            glEnableVertexAttribArray(3);
-            // Enable index 4 (bitangents)
-            glEnableVertexAttribArray(4);
+            // If the 3D Model has normal mapping
+            if (hasNormalMapping) {
+                std::copy(vertex + ptrOffset, vertex + ptrOffset + TAN_SIZE, arenaVertex + ARENA_TANGENT_OFFSET);
+                std::copy(vertex + ptrOffset + TAN_SIZE, vertex + ptrOffset + TAN_SIZE + BITAN_SIZE, arenaVertex + ARENA_BITANGENT_OFFSET);
+            }
         }
 
-        // Reset buffer bindings
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        this->mesh = GeometryArena::shared().allocate(arenaVertexData);
     }
 
 public:
@@ -532,19 +611,29 @@ public:
         glm::vec3 color = glm::vec3(0.0f, 1.0f, 0.0f)
     ) {
         // Initialize attributes
+        this->objPath = objPath;
+        this->texturePaths = texturePaths;
         this->position = position;
         this->rotation = rotation;
         this->scale = scale;
         this->color = color;
 
         this->showColor = false;
-        this->hasNormals = true;
-        this->hasTexCoords = true;
+        this->hasAlphaCutout = false;
+        this->occlusionID = 0;
+        this->isOccluder = false;
+        this->isInstanced = false;
+        this->instanceBuffer = 0;
         this->hasTexture = texturePaths.size() > 0 ? true : false;
         this->hasNormalMapping = normalMapPath.size() > 0 ? true : false;
+        this->normalMapPath = normalMapPath;
 
         // Load the contents of the .obj file provided
-        this->loadObjData(objPath);
+        ObjData objData;
+        this->loadObjData(objPath, objData);
+        this->fullVertexData.swap(objData.fullVertexData);
+        this->hasNormals = objData.hasNormals;
+        this->hasTexCoords = objData.hasTexCoords;
 
         // If the model has textures, then load it
         if (hasTexture)
@@ -568,19 +657,28 @@ public:
         glm::vec3 color = glm::vec3(0.0f, 1.0f, 0.0f)
     ) {
         // Initialize attributes
+        this->objPath = objPath;
+        this->texturePaths = texturePaths;
         this->position = position;
         this->rotation = rotation;
         this->scale = scale;
         this->color = color;
 
         this->showColor = false;
-        this->hasNormals = true;
-        this->hasTexCoords = true;
+        this->hasAlphaCutout = false;
+        this->occlusionID = 0;
+        this->isOccluder = false;
+        this->isInstanced = false;
+        this->instanceBuffer = 0;
         this->hasTexture = texturePaths.size() > 0 ? true : false;
         this->hasNormalMapping = false;
 
         // Load the contents of the .obj file provided
-        this->loadObjData(objPath);
+        ObjData objData;
+        this->loadObjData(objPath, objData);
+        this->fullVertexData.swap(objData.fullVertexData);
+        this->hasNormals = objData.hasNormals;
+        this->hasTexCoords = objData.hasTexCoords;
 
         // If the model has textures, then load it
         if (hasTexture)
@@ -590,94 +688,269 @@ public:
         this->bindObjData();
     }
 
-    // Draw the model using the shader.
-    void draw(Shader shader) {
-        // Bind the model's VAO
-        glBindVertexArray(this->VAO);
+    /******** HOT-RELOAD FUNCTIONS ********/
+    // Re-imports the .obj file of this model. Returns the step that swaps the new mesh in, or an empty function if loading failed.
+    std::function<void()> prepareObjReload() {
+        std::shared_ptr<ObjData> objData = std::make_shared<ObjData>();
+        if (!this->loadObjData(this->objPath, *objData) || objData->fullVertexData.empty())
+            return nullptr;
+
+        return [this, objData]() {
+            // Release the old mesh before storing the new one, so that its space can be reused
+            GeometryArena::shared().free(this->mesh);
+
+            this->fullVertexData.swap(objData->fullVertexData);
+            this->hasNormals = objData->hasNormals;
+            this->hasTexCoords = objData->hasTexCoords;
+            this->bindObjData();
+        };
+    }
+
+    // Re-decodes the texture at the given index. Returns the step that swaps the new texture in, or an empty function if loading failed.
+    std::function<void()> prepareTextureReload(int index) {
+        int imgWidth, imgHeight, colorChannels;
+        unsigned char* tex_bytes = stbi_load(this->texturePaths[index].c_str(), &imgWidth, &imgHeight, &colorChannels, 0);
+        if (!tex_bytes)
+            return nullptr;
+
+        // Free the decoded image once the swap step is done with it
+        std::shared_ptr<unsigned char> image(tex_bytes, stbi_image_free);
+        bool hasAlphaCutout = needsAlphaCutout(tex_bytes, imgWidth, imgHeight, colorChannels);
+
+        return [this, index, image, imgWidth, imgHeight, colorChannels, hasAlphaCutout]() {
+            GLuint textureUnit = GL_TEXTURE0 + index;
+            GLuint textureID = createTexture(image.get(), imgWidth, imgHeight, colorChannels, textureUnit);
+            if (index == 0)
+                this->hasAlphaCutout = hasAlphaCutout;
+
+            // Replace the old texture of the same texture unit
+            for (Texture& texture : this->textures) {
+                if (texture.getTextureUnit() == textureUnit) {
+                    GLuint oldTextureID = texture.getTextureID();
+                    glDeleteTextures(1, &oldTextureID);
+                    texture = Texture(textureID, textureUnit);
+                    return;
+                }
+            }
+
+            // The texture failed to load before, so add it now
+            this->textures.push_back(Texture(textureID, textureUnit));
+        };
+    }
+
+    // Re-decodes the normal map of this model. Returns the step that swaps the new normal map in, or an empty function if loading failed.
+    std::function<void()> prepareNormalMapReload() {
+        int imgWidth, imgHeight, colorChannels;
+        unsigned char* norm_bytes = stbi_load(this->normalMapPath.c_str(), &imgWidth, &imgHeight, &colorChannels, 0);
+        if (!norm_bytes)
+            return nullptr;
+
+        // Free the decoded image once the swap step is done with it
+        std::shared_ptr<unsigned char> image(norm_bytes, stbi_image_free);
+
+        return [this, image, imgWidth, imgHeight]() {
+            GLuint oldTextureID = this->normalMap.getTextureID();
+            this->normalMap = Texture(createNormalMap(image.get(), imgWidth, imgHeight), NORM_MAP_UNIT);
+            glDeleteTextures(1, &oldTextureID);
+        };
+    }
+
+    // Watches the .obj file, textures, and normal map of this model so they are hot-reloaded when changed on disk.
+    // The model must not be moved or copied afterwards.
+    void watchAssets(AssetWatcher& watcher) {
+        watcher.watch(this->objPath, [this]() { return this->prepareObjReload(); });
+
+        for (int i = 0; i < (int)this->texturePaths.size() && i < TEXT_LIMIT; i++)
+            watcher.watch(this->texturePaths[i], [this, i]() { return this->prepareTextureReload(i); });
+
+        if (this->hasNormalMapping)
+            watcher.watch(this->normalMapPath, [this]() { return this->prepareNormalMapReload(); });
+    }
+
+    // Submit the model to be drawn with the other objects of the batch.
+    void submit(ObjectBatch& batch) {
+        ObjectData data = ObjectData();
 
         // Compute for the transformation matrix; check if around world origin or not
-        glm::mat4 transMatrix = computeTransMatrix();
+        data.model = computeTransMatrix();
+
+        // Compute for the Normal Matrix once, instead of per vertex in the shader
+        data.setNormalMatrix(computeNormalMatrix(data.model));
 
-        // Link the Model Matrix to the shader program
-        shader.setMat4("model", transMatrix);
+        // Select the shader variant; a model showing its color needs neither textures nor lighting
+        GLuint flags = 0;
+        if (this->showColor)
+            flags = OBJECT_SHOW_COLOR;
+        else {
+            if (this->hasNormalMapping)
+                flags |= OBJECT_HAS_NORMAL_MAPPING;
+            if (this->hasTexture)
+                flags |= OBJECT_HAS_TEXTURE;
+            if (this->hasTexture && this->hasAlphaCutout)
+                flags |= OBJECT_ALPHA_CUTOUT;
+        }
 
-        // Tell the shader if this model uses normal mapping or not
-        shader.setBool("hasNormalMapping", this->hasNormalMapping);
+        // The model's color
+        data.color = glm::vec4(this->color, 1.0f);
 
-        // Tell the shader if this model uses texture/s or not
-        shader.setBool("hasTexture", this->hasTexture);
+        // Only bind the textures the shader samples
+        Texture texture = (flags & OBJECT_HAS_TEXTURE) && this->textures.size() > 0 ? this->textures[0] : Texture();
+        Texture normalMap = (flags & OBJECT_HAS_NORMAL_MAPPING) ? this->normalMap : Texture();
 
-        // Tel the shader if this model must use its color
-        shader.setBool("showColor", this->showColor);
+        // Draw every instance at once, placed by the model's transformation
+        if (this->isInstanced) {
+            InstanceSet set;
+            set.buffer = this->instanceBuffer;
+            set.instances = &this->instanceData;
+            set.meshSphere = this->localSphere;
 
-        // If the model has normal mapping, bind it
-        if (this->hasNormalMapping) {
-            // Bind the 3D model's normal mapping
-            normalMap.bind();
-            shader.setInt("norm_tex0", NORM_MAP_LOC);
+            batch.addInstances(flags, this->mesh, texture, normalMap, data, set,
+                this->instanceBounds.transform(data.model), this->instanceSphere.transform(data.model), this->occlusionID);
+            return;
         }
 
-        // If the model has texture/s, bind it
-        if (this->hasTexture && !this->showColor) {
-            // Iterate through all possible texture units
-            for (int i = 0; i < textures.size(); i++) {
-                // Bind the 3D model's texture
-                this->textures[i].bind();
-                shader.setInt("tex" + std::to_string(i), i);
-            }
+        // Bounding volumes in world space, for culling
+        AABB bounds = this->localBounds.transform(data.model);
+        BoundingSphere sphere = this->localSphere.transform(data.model);
+
+        batch.add(flags, this->mesh, texture, normalMap, data, bounds, sphere, this->occlusionID);
+
+        // Hide the objects behind this model
+        if (this->isOccluder)
+            batch.addOccluder(this->occluderVertices, data.model);
+    }
+
+    // Switches the model to instance mode, drawing one copy of its mesh per instance; replaces the previous instances.
+    void setInstances(const std::vector<ModelInstance>& instances) {
+        this->isInstanced = true;
+        this->instanceData.clear();
+
+        for (const ModelInstance& instance : instances) {
+            if (instance.flags & MODEL_INSTANCE_HIDDEN)
+                continue;
+
+            ObjectData data = ObjectData();
+            data.model = computeTransMatrix(instance.position, instance.rotation, instance.scale);
+            data.setNormalMatrix(computeNormalMatrix(data.model, instance.scale));
+            data.color = glm::vec4(instance.color, 1.0f);
+            this->instanceData.push_back(data);
         }
-        // Else, use the model's color
-        else {
-            // Bind the 3D model's color
-            shader.setVec3("modelColor", this->color);
+        this->computeInstanceBounds();
+
+        // Upload the instances once; they are culled and placed by the model's transformation on the GPU every frame
+        if (this->instanceBuffer == 0)
+            glGenBuffers(1, &this->instanceBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->instanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, this->instanceData.size() * sizeof(ObjectData), this->instanceData.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // Switches the model back to drawing a single copy of its mesh.
+    void clearInstances() {
+        this->isInstanced = false;
+        this->instanceData.clear();
+
+        if (this->instanceBuffer != 0) {
+            glDeleteBuffers(1, &this->instanceBuffer);
+            this->instanceBuffer = 0;
         }
+    }
 
-        // Draw the model itself
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)fullVertexData.size() / this->dataLen);
-        glBindVertexArray(0);
+    // Returns the sphere enclosing the model (every instance, in instance mode) in world space.
+    BoundingSphere computeBoundingSphere() {
+        glm::mat4 transMatrix = computeTransMatrix();
+        return this->isInstanced ? this->instanceSphere.transform(transMatrix) : this->localSphere.transform(transMatrix);
     }
 
     // Helper function for computing the translation matrix of a 3D model.
     glm::mat4 computeTransMatrix() {
+        return computeTransMatrix(this->position, this->rotation, this->scale);
+    }
+
+    // Helper function for computing the translation matrix of the given position, rotation, and scale.
+    static glm::mat4 computeTransMatrix(const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale) {
         // Initialize the Model Matrix as an identity matrix
         glm::mat4 transMatrix = glm::mat4(1.0f);
 
         // Apply a translation to the Model Matrix
         transMatrix = glm::translate(
             transMatrix,
-            this->position
+            position
         );
 
         // Apply an Y-axis rotation to the Model Matrix
         transMatrix = glm::rotate(
             transMatrix,
-            glm::radians(this->rotation.y),
+            glm::radians(rotation.y),
             glm::normalize(glm::vec3(0.0f, 1.0f, 0.0f))
         );
 
         // Apply an X-axis rotation to the Model Matrix
         transMatrix = glm::rotate(
             transMatrix,
-            glm::radians(this->rotation.x),
+            glm::radians(rotation.x),
             glm::normalize(glm::vec3(1.0f, 0.0f, 0.0f))
         );
 
         // Apply an Z-axis rotation to the Model Matrix
         transMatrix = glm::rotate(
             transMatrix,
-            glm::radians(this->rotation.z),
+            glm::radians(rotation.z),
             glm::normalize(glm::vec3(0.0f, 0.0f, 1.0f))
         );
 
         // Apply scaling to the Model Matrix
         transMatrix = glm::scale(
             transMatrix,
-            this->scale
+            scale
         );
 
         return transMatrix;
     }
 
+    // Helper function for computing the normal matrix of a 3D model from its transformation matrix.
+    glm::mat3 computeNormalMatrix(const glm::mat4& transMatrix) {
+        return computeNormalMatrix(transMatrix, this->scale);
+    }
+
+    // Helper function for computing the normal matrix of a transformation matrix built with the given scale.
+    static glm::mat3 computeNormalMatrix(const glm::mat4& transMatrix, const glm::vec3& scale) {
+        // The upper 3x3 of the transformation matrix is a rotation R times the scale S
+        glm::mat3 rotScale = glm::mat3(transMatrix);
+
+        // A degenerate scale has no proper normal matrix; leave it to the general inverse
+        if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+            return glm::transpose(glm::inverse(rotScale));
+
+        // Uniform scale: the inverse transpose R * S^-1 equals (R * S) / scale^2
+        if (scale.x == scale.y && scale.y == scale.z)
+            return rotScale * (1.0f / (scale.x * scale.x));
+
+        // Non-uniform scale: undo the scaling per axis, (R * S) * S^-2
+        glm::vec3 invScaleSq = 1.0f / (scale * scale);
+        rotScale[0] *= invScaleSq.x;
+        rotScale[1] *= invScaleSq.y;
+        rotScale[2] *= invScaleSq.z;
+        return rotScale;
+    }
+
+    // Toggles occlusion testing; worthwhile for large models that are often hidden behind others.
+    void toggleOcclusionCulling(bool use) {
+        if (!use)
+            this->occlusionID = 0;
+        else if (this->occlusionID == 0)
+            this->occlusionID = generateOcclusionID();
+    }
+
+    // Toggles use of this model as an occluder for software occlusion culling; worthwhile for large models in front of many others.
+    void toggleOccluder(bool use) {
+        if (this->isOccluder == use)
+            return;
+
+        this->isOccluder = use;
+        this->extractOccluderVertices();
+    }
+
     // Toggles texture color usage; to use default texture color or green only.
     void toggleColor(bool use) {
         this->showColor = use;
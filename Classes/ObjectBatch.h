@@ -0,0 +1,742 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "Frustum.h"
+#include "GeometryArena.h"
+#include "InstanceCuller.h"
+#include "OcclusionCuller.h"
+#include "SoftwareOcclusionCuller.h"
+#include "RenderQueue.h"
+#include "StreamBuffer.h"
+
+/******** OBJECT BUFFER BINDINGS ********/
+// Must match the layout qualifiers in main.vert
+// Binding point of ObjectBlock (shader storage buffer)
+const GLuint OBJECT_BLOCK_BINDING = 0;
+
+/******** OBJECT FLAGS ********/
+// Each flag selects a shader variant by enabling a define in main.vert and main.frag
+// The object uses normal mapping
+const GLuint OBJECT_HAS_NORMAL_MAPPING = 1u << 0;
+// The object has texture/s
+const GLuint OBJECT_HAS_TEXTURE = 1u << 1;
+// The object must use its color instead of its texture
+const GLuint OBJECT_SHOW_COLOR = 1u << 2;
+// The object's texture has transparent pixels that must be discarded
+const GLuint OBJECT_ALPHA_CUTOUT = 1u << 3;
+// Define enabled by each flag, in bit order
+const char* const OBJECT_FLAG_DEFINES[] = { "HAS_NORMAL_MAPPING", "HAS_TEXTURE", "SHOW_COLOR", "ALPHA_CUTOUT" };
+
+// Attributes of a single drawn object (std430 layout of ObjectData in main.vert).
+struct ObjectData {
+    glm::mat4 model;
+    // Columns of a mat3; std430 pads each column to a vec4
+    glm::vec4 normalMatrix[3];
+    glm::vec4 color;
+
+    // Stores the normal matrix into its padded columns.
+    void setNormalMatrix(const glm::mat3& matrix) {
+        for (int i = 0; i < 3; i++)
+            this->normalMatrix[i] = glm::vec4(matrix[i], 0.0f);
+    }
+
+    // Returns the normal matrix from its padded columns.
+    glm::mat3 getNormalMatrix() const {
+        return glm::mat3(glm::vec3(this->normalMatrix[0]), glm::vec3(this->normalMatrix[1]), glm::vec3(this->normalMatrix[2]));
+    }
+};
+
+static_assert(sizeof(ObjectData) == 128, "ObjectData must match its std430 layout");
+
+// Instances of a mesh placed relative to a parent transformation, kept on both the GPU and the CPU (see Model::setInstances).
+struct InstanceSet {
+    // Shader storage buffer holding the attributes of the instances, relative to the parent
+    GLuint buffer;
+    // The same attributes on the CPU, for drawing without GPU culling
+    const std::vector<ObjectData>* instances;
+    // Bounding sphere of the mesh in model space
+    BoundingSphere meshSphere;
+};
+
+// Command of an indirect indexed draw call (layout read by glMultiDrawElementsIndirect).
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/*
+    Object Batch class implementation. Collects the objects drawn in a frame, writes their attributes
+    to the stream buffer at once (read as a shader storage buffer), and draws all objects sharing a shader variant and textures with
+    a single multi-draw indirect call. Meshes live in the shared geometry arena, so every draw uses the
+    same VAO; each command of a call draws one mesh for all of its objects with instancing.
+
+    Draws are ordered through a render queue by shader variant, material, mesh, and depth, so objects
+    within a draw call go front-to-back for early depth rejection.
+
+    With a depth pre-pass, the opaque objects are first drawn depth-only from a position-only vertex
+    stream, then shaded with an equal depth test, so every pixel is shaded once. Objects with
+    alpha-cutout textures skip the pre-pass and are shaded afterwards with a regular depth test.
+
+    Objects outside the camera's view volume are culled before sorting: their bounding spheres are
+    tested in batches first, and the bounding boxes of the remaining objects refine the result. When a
+    software occlusion culler is set, every object is then tested against the occluders submitted for
+    the frame. Objects with an occlusion ID are also tested with GPU queries when an occlusion culler is set.
+
+    Each instance reads its attributes through a per-instance index attribute, which starts at the
+    base instance of the draw call; no per-object uniforms are set.
+
+    Groups of many copies of a mesh (such as schools of creatures) are submitted as a single draw with
+    their instances' attributes. They are culled and sorted as a whole; when an instance culler is set,
+    their instances are then culled one by one on the GPU, which writes the visible ones and their count
+    straight into the object attributes and draw commands. Otherwise they are placed on the CPU.
+ */
+class ObjectBatch {
+private:
+    // A mesh submitted to be drawn for one object
+    struct Draw {
+        GLuint variant;
+        // Mesh in the geometry arena
+        ArenaMesh mesh;
+        Texture texture;
+        Texture normalMap;
+        // Index of the first object attributes of the draw
+        GLuint objectIndex;
+        // Number of objects drawn (more than one for instanced groups)
+        GLuint instanceCount;
+        // Flag to determine if the draw is an instanced group; its object attributes are the parent's
+        bool hasInstanceSet;
+        // Instances of the group
+        InstanceSet instanceSet;
+        // World-space position the draw is depth-sorted by
+        glm::vec3 position;
+        // World-space bounding box of the object
+        AABB bounds;
+        // Occlusion ID of the object (0 if it is not tested for occlusion)
+        GLuint occlusionID;
+        // Query whose result decides if the object is drawn (0 to always draw it)
+        GLuint conditionQuery;
+    };
+
+    // Sampler handles of a shader variant the batch is drawn with
+    struct BatchUniforms {
+        Uniform<int> tex;
+        Uniform<int> normTex;
+
+        BatchUniforms(const Shader& shader) {
+            this->tex = shader.getUniform<int>("tex0");
+            this->normTex = shader.getUniform<int>("norm_tex0");
+        }
+    };
+    // Cached uniform handles per shader variant the batch is drawn with
+    UniformCache<BatchUniforms> uniforms;
+
+    // Attributes of the submitted objects, in submission order
+    std::vector<ObjectData> objects;
+    // Meshes of the submitted objects
+    std::vector<Draw> draws;
+    // World-space bounding spheres of the submitted objects, tested together
+    std::vector<BoundingSphere> spheres;
+    // Result of the sphere test per submitted object (1 if visible)
+    std::vector<unsigned char> visibility;
+    // Index of the first object attributes of each sorted draw in the uploaded attributes
+    std::vector<GLuint> sortedOffsets;
+    // Flag to determine if instanced groups are culled on the GPU this frame
+    bool isCullingOnGPU;
+    // Instanced groups culled on the GPU this frame
+    std::vector<InstanceCuller::Job> cullJobs;
+    // Command of each sorted draw culled on the GPU, per pass (-1 for none)
+    std::vector<GLint> itemCommands;
+    std::vector<GLint> itemDepthCommands;
+
+    // Sorted draws submitted with one multi-draw call
+    struct DrawGroup {
+        // Index of the group's first item in the render queue
+        size_t firstItem;
+        // Range of the group's commands in the indirect buffer
+        GLuint firstCommand;
+        GLsizei commandCount;
+    };
+    // Commands of the depth pre-pass and main pass groups, uploaded at once
+    std::vector<DrawElementsIndirectCommand> commands;
+    // Groups of the depth pre-pass
+    std::vector<DrawGroup> depthGroups;
+    // Groups of the main pass
+    std::vector<DrawGroup> groups;
+    // Draw order of the submitted objects
+    RenderQueue queue;
+    // View matrix of the camera the objects are drawn with; used for depth sorting
+    glm::mat4 view;
+    // Depth range used to quantize depths (the camera's zFar)
+    float maxDepth;
+    // View volume of the camera the objects are drawn with
+    Frustum frustum;
+    // Tests objects for occlusion with GPU queries (may be NULL)
+    OcclusionCuller* occlusionCuller;
+    // Tests objects for occlusion against occluders rasterized on the CPU (may be NULL)
+    SoftwareOcclusionCuller* softwareCuller;
+    // Culls the instances of instanced groups on the GPU (may be NULL)
+    InstanceCuller* instanceCuller;
+    // Shader of the depth pre-pass (NULL if there is no depth pre-pass)
+    Shader* depthShader;
+
+    // Object attributes of this frame in the stream buffer, read as a shader storage buffer
+    StreamBuffer::Allocation objectAllocation;
+    // Indirect draw commands of this frame in the stream buffer
+    StreamBuffer::Allocation commandAllocation;
+    // Number of draw calls issued by the last draw
+    GLuint drawCallCount;
+    // Number of objects drawn by the last draw
+    GLuint visibleCount;
+    // Number of objects culled by the last draw
+    GLuint culledCount;
+    // Number of objects skipped by the last draw because they were occluded
+    GLuint occludedCount;
+
+    // Tests the drawn objects' bounding boxes for occlusion, for the next frames.
+    void issueOcclusionQueries() {
+        if (this->occlusionCuller != NULL)
+            this->occlusionCuller->issueQueries();
+    }
+
+    // Returns true if the draw is part of the depth pre-pass.
+    static bool isInDepthPrePass(const Draw& draw) {
+        return !(draw.variant & OBJECT_ALPHA_CUTOUT);
+    }
+
+    // Returns true if two draws can be part of the same depth-only multi-draw call.
+    static bool canShareDepthDrawCall(const Draw& a, const Draw& b) {
+        return isInDepthPrePass(a) == isInDepthPrePass(b) &&
+            a.conditionQuery == b.conditionQuery;
+    }
+
+    // Returns true if two draws can be part of the same multi-draw call.
+    static bool canShareDrawCall(const Draw& a, const Draw& b) {
+        return a.variant == b.variant &&
+            a.conditionQuery == b.conditionQuery &&
+            a.texture.getTextureID() == b.texture.getTextureID() &&
+            a.normalMap.getTextureID() == b.normalMap.getTextureID();
+    }
+
+    // Returns true if the instances of the draw are culled on the GPU this frame.
+    bool isCulledOnGPU(const Draw& draw) const {
+        return this->isCullingOnGPU && draw.hasInstanceSet;
+    }
+
+    // Splits the sorted items into groups of draws that can share a multi-draw call, and appends the commands of
+    // the groups accepted by the filter (all if NULL). Consecutive draws of the same mesh become one instanced command.
+    // Draws culled on the GPU get a command of their own, starting with no instances; its index is stored in itemCommands.
+    void buildGroups(const std::vector<RenderQueue::Item>& items, bool (*canShare)(const Draw&, const Draw&),
+        bool (*filter)(const Draw&), std::vector<DrawGroup>& groups, std::vector<GLint>& itemCommands) {
+        groups.clear();
+        itemCommands.assign(items.size(), -1);
+        for (size_t first = 0; first < items.size(); ) {
+            const Draw& draw = this->draws[items[first].index];
+
+            size_t last = first + 1;
+            while (last < items.size() && canShare(this->draws[items[last].index], draw))
+                last++;
+
+            if (filter == NULL || filter(draw)) {
+                DrawGroup group;
+                group.firstItem = first;
+                group.firstCommand = (GLuint)this->commands.size();
+
+                for (size_t run = first; run < last; ) {
+                    const Draw& runDraw = this->draws[items[run].index];
+                    const ArenaMesh& mesh = runDraw.mesh;
+                    bool isRunCulledOnGPU = this->isCulledOnGPU(runDraw);
+
+                    // Draws placed on the CPU are stored one after another, so their instances can be merged
+                    GLuint instanceCount = runDraw.instanceCount;
+                    size_t runEnd = run + 1;
+                    while (!isRunCulledOnGPU && runEnd < last && this->draws[items[runEnd].index].mesh.id == mesh.id &&
+                        !this->isCulledOnGPU(this->draws[items[runEnd].index])) {
+                        instanceCount += this->draws[items[runEnd].index].instanceCount;
+                        runEnd++;
+                    }
+
+                    if (isRunCulledOnGPU) {
+                        itemCommands[run] = (GLint)this->commands.size();
+                        instanceCount = 0;
+                    }
+
+                    // Instance i of the command reads the attributes at index (baseInstance + i)
+                    DrawElementsIndirectCommand command;
+                    command.count = mesh.indexCount;
+                    command.instanceCount = instanceCount;
+                    command.firstIndex = mesh.firstIndex;
+                    command.baseVertex = mesh.baseVertex;
+                    command.baseInstance = this->sortedOffsets[run];
+                    this->commands.push_back(command);
+
+                    run = runEnd;
+                }
+
+                group.commandCount = (GLsizei)(this->commands.size() - group.firstCommand);
+                groups.push_back(group);
+            }
+
+            first = last;
+        }
+    }
+
+    // Writes the commands of every group to the stream buffer and binds them as the indirect buffer.
+    void uploadCommands() {
+        this->commandAllocation = StreamBuffer::shared().allocate(this->commands.size() * sizeof(DrawElementsIndirectCommand));
+        if (this->commandAllocation.data != NULL)
+            std::copy(this->commands.begin(), this->commands.end(), (DrawElementsIndirectCommand*)this->commandAllocation.data);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandAllocation.buffer);
+    }
+
+    // Issues the multi-draw call of a group; the indirect buffer and VAO must be bound.
+    void drawGroup(const DrawGroup& group) {
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+            (void*)(this->commandAllocation.offset + group.firstCommand * sizeof(DrawElementsIndirectCommand)), group.commandCount, 0);
+        this->drawCallCount++;
+    }
+
+    // Draws the groups with a shader reading the position-only vertex stream; masks and depth state are left as they are.
+    void drawPositionOnly(const std::vector<RenderQueue::Item>& items, const std::vector<DrawGroup>& groups, Shader* shader) {
+        shader->use();
+
+        GLState::bindVertexArray(GeometryArena::shared().getDepthVertexArray());
+
+        for (const DrawGroup& group : groups) {
+            const Draw& draw = this->draws[items[group.firstItem].index];
+
+            if (draw.conditionQuery != 0)
+                glBeginConditionalRender(draw.conditionQuery, GL_QUERY_NO_WAIT);
+
+            this->drawGroup(group);
+
+            if (draw.conditionQuery != 0)
+                glEndConditionalRender();
+        }
+    }
+
+    // Draws the depth of every object of the depth groups.
+    void drawDepthPrePass(const std::vector<RenderQueue::Item>& items) {
+        GLState::setColorMask(false);
+        GLState::setDepthTest(true);
+        GLState::setDepthMask(true);
+        GLState::setDepthFunc(GL_LESS);
+        this->drawPositionOnly(items, this->depthGroups, this->depthShader);
+    }
+
+    // Culls the submitted draws and orders the visible ones by shader variant, material, mesh, and depth (front-to-back).
+    const std::vector<RenderQueue::Item>& sortVisibleDraws() {
+        // Cull the objects outside the view volume; spheres are cheap to test in batches, boxes are tighter
+        this->frustum.intersects(this->spheres, this->visibility);
+
+        // Draw the occluders of this frame into the CPU depth pyramid
+        if (this->softwareCuller != NULL)
+            this->softwareCuller->rasterize();
+
+        this->queue.clear();
+        for (uint32_t i = 0; i < this->draws.size(); i++) {
+            Draw& draw = this->draws[i];
+            if (!this->visibility[i] || !this->frustum.intersects(draw.bounds)) {
+                this->culledCount += draw.instanceCount;
+                continue;
+            }
+
+            // Skip objects hidden behind the occluders of this frame
+            if (this->softwareCuller != NULL && !this->softwareCuller->isVisible(draw.bounds)) {
+                this->occludedCount += draw.instanceCount;
+                continue;
+            }
+
+            // Skip objects found hidden by earlier occlusion queries
+            if (draw.occlusionID != 0 && this->occlusionCuller != NULL &&
+                this->occlusionCuller->test(draw.occlusionID, draw.bounds, draw.conditionQuery) == OCCLUSION_HIDDEN) {
+                this->occludedCount += draw.instanceCount;
+                continue;
+            }
+
+            float depth = -(this->view * glm::vec4(draw.position, 1.0f)).z;
+            uint32_t material = (draw.texture.getTextureID() << 8) ^ draw.normalMap.getTextureID();
+            RenderPass pass = isInDepthPrePass(draw) ? RENDER_PASS_OPAQUE : RENDER_PASS_ALPHA_CUTOUT;
+            this->queue.push(RenderQueue::makeKey(pass, draw.variant, material, draw.mesh.id, depth, this->maxDepth), i);
+        }
+        this->queue.sort();
+        return this->queue.getItems();
+    }
+
+    // Writes the attributes of the sorted draws to the stream buffer, so that each draw call reads a contiguous range.
+    void uploadObjects(const std::vector<RenderQueue::Item>& items) {
+        // Lay out the object attributes in draw order, so that each draw call reads a contiguous range;
+        // groups culled on the GPU write their visible instances after the rest, and all of them count as drawn
+        this->isCullingOnGPU = this->instanceCuller != NULL && this->instanceCuller->isReady();
+        this->sortedOffsets.assign(items.size(), 0);
+        GLuint objectCount = 0;
+        for (int isGPUPass = 0; isGPUPass < 2; isGPUPass++) {
+            for (size_t i = 0; i < items.size(); i++) {
+                const Draw& draw = this->draws[items[i].index];
+                if (this->isCulledOnGPU(draw) != (isGPUPass != 0))
+                    continue;
+
+                this->sortedOffsets[i] = objectCount;
+                objectCount += draw.instanceCount;
+            }
+        }
+        this->visibleCount = objectCount;
+        GeometryArena::shared().reserveObjects(objectCount);
+
+        // Write the attributes placed on the CPU straight into the stream buffer
+        this->objectAllocation = StreamBuffer::shared().allocate(objectCount * sizeof(ObjectData));
+        ObjectData* sortedObjects = (ObjectData*)this->objectAllocation.data;
+        for (size_t i = 0; i < items.size() && sortedObjects != NULL; i++) {
+            const Draw& draw = this->draws[items[i].index];
+            if (this->isCulledOnGPU(draw))
+                continue;
+
+            ObjectData* sortedObject = sortedObjects + this->sortedOffsets[i];
+            if (!draw.hasInstanceSet) {
+                std::copy(this->objects.begin() + draw.objectIndex, this->objects.begin() + draw.objectIndex + draw.instanceCount, sortedObject);
+                continue;
+            }
+
+            // Without GPU culling, every instance of the group is placed by the parent here
+            const ObjectData& parent = this->objects[draw.objectIndex];
+            glm::mat3 parentNormalMatrix = parent.getNormalMatrix();
+            for (const ObjectData& local : *draw.instanceSet.instances) {
+                sortedObject->model = parent.model * local.model;
+                sortedObject->setNormalMatrix(parentNormalMatrix * local.getNormalMatrix());
+                sortedObject->color = local.color;
+                sortedObject++;
+            }
+        }
+    }
+
+    // Culls the instances of the groups on the GPU once the commands are uploaded, and binds the object attributes.
+    void cullInstances(const std::vector<RenderQueue::Item>& items) {
+        // Cull the instances of the groups on the GPU, straight into the object attributes and the commands
+        this->cullJobs.clear();
+        for (size_t i = 0; i < items.size(); i++) {
+            const Draw& draw = this->draws[items[i].index];
+            if (!this->isCulledOnGPU(draw) || this->itemCommands[i] < 0)
+                continue;
+
+            const ObjectData& parent = this->objects[draw.objectIndex];
+            InstanceCuller::Job job;
+            job.instanceBuffer = draw.instanceSet.buffer;
+            job.instanceCount = draw.instanceCount;
+            job.parentModel = parent.model;
+            job.parentNormalMatrix = parent.getNormalMatrix();
+            job.meshSphere = draw.instanceSet.meshSphere;
+            job.firstObject = this->sortedOffsets[i];
+            job.command = this->itemCommands[i];
+            job.depthCommand = this->itemDepthCommands[i];
+            this->cullJobs.push_back(job);
+        }
+        if (!this->cullJobs.empty()) {
+            this->instanceCuller->setDepthPyramid(this->softwareCuller);
+            this->instanceCuller->cull(this->cullJobs, this->objectAllocation, this->commandAllocation);
+        }
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, OBJECT_BLOCK_BINDING,
+            this->objectAllocation.buffer, this->objectAllocation.offset, this->objectAllocation.size);
+    }
+
+    // Resets the counts of the last draw.
+    void resetCounts() {
+        this->drawCallCount = 0;
+        this->visibleCount = 0;
+        this->culledCount = 0;
+        this->occludedCount = 0;
+    }
+
+    // Culls, sorts, and uploads the submitted draws for a single pass drawing every object with the position-only
+    // vertex stream, grouped into the depth groups. Returns NULL if nothing is visible.
+    const std::vector<RenderQueue::Item>* prepareSinglePass() {
+        this->resetCounts();
+        if (this->draws.empty())
+            return NULL;
+
+        const std::vector<RenderQueue::Item>& items = this->sortVisibleDraws();
+        if (items.empty()) {
+            this->issueOcclusionQueries();
+            return NULL;
+        }
+        this->uploadObjects(items);
+
+        // A single pass; its commands are the ones culled into
+        this->commands.clear();
+        this->groups.clear();
+        this->itemDepthCommands.assign(items.size(), -1);
+        this->buildGroups(items, canShareDepthDrawCall, NULL, this->depthGroups, this->itemCommands);
+        this->uploadCommands();
+
+        this->cullInstances(items);
+        return &items;
+    }
+
+public:
+    // Instantiates an Object Batch object able to hold the given number of objects before growing.
+    ObjectBatch(GLuint capacity = 64) {
+        this->objectAllocation = StreamBuffer::Allocation();
+        this->commandAllocation = StreamBuffer::Allocation();
+        this->drawCallCount = 0;
+        this->visibleCount = 0;
+        this->culledCount = 0;
+        this->occludedCount = 0;
+        this->occlusionCuller = NULL;
+        this->softwareCuller = NULL;
+        this->depthShader = NULL;
+        this->instanceCuller = NULL;
+        this->isCullingOnGPU = false;
+        this->view = glm::mat4(1.0f);
+        this->maxDepth = 1.0f;
+
+        GeometryArena::shared().reserveObjects(capacity);
+    }
+
+    // Clears the objects submitted for the previous frame. Objects are culled and depth-sorted for the given camera.
+    void begin(const CameraBlock& camera) {
+        this->view = camera.view;
+        this->maxDepth = camera.zFar;
+        this->frustum = Frustum(camera.projection, camera.view);
+        if (this->occlusionCuller != NULL)
+            this->occlusionCuller->begin(camera);
+        if (this->softwareCuller != NULL)
+            this->softwareCuller->begin(camera);
+
+        this->objects.clear();
+        this->draws.clear();
+        this->spheres.clear();
+    }
+
+    // Submits a mesh to be drawn with the given object attributes, using the shader variant of the object flags.
+    // Objects with a texture or normal map ID of 0 are drawn without one bound. The bounding volumes are in world space.
+    // Objects with a non-zero occlusion ID (unique per object) are tested for occlusion. Empty meshes are ignored.
+    void add(GLuint flags, const ArenaMesh& mesh, Texture texture, Texture normalMap, const ObjectData& data,
+        const AABB& bounds, const BoundingSphere& sphere, GLuint occlusionID = 0) {
+        if (mesh.id == 0)
+            return;
+
+        Draw draw;
+        draw.variant = flags;
+        draw.mesh = mesh;
+        draw.texture = texture;
+        draw.normalMap = normalMap;
+        draw.objectIndex = (GLuint)this->objects.size();
+        draw.instanceCount = 1;
+        draw.hasInstanceSet = false;
+        draw.position = glm::vec3(data.model[3]);
+        draw.bounds = bounds;
+        draw.occlusionID = occlusionID;
+        draw.conditionQuery = 0;
+
+        this->objects.push_back(data);
+        this->draws.push_back(draw);
+        this->spheres.push_back(sphere);
+    }
+
+    // Submits many copies of a mesh, placed by the parent's attributes, to be drawn with a single instanced draw call.
+    // The copies share the shader variant, textures, and occlusion ID; the bounding volumes in world space enclose all of them.
+    // The instance set must stay unchanged until the batch is drawn. Copies are culled one by one on the GPU if an
+    // instance culler is set and ready, and drawn as a whole otherwise.
+    void addInstances(GLuint flags, const ArenaMesh& mesh, Texture texture, Texture normalMap, const ObjectData& parent,
+        const InstanceSet& set, const AABB& bounds, const BoundingSphere& sphere, GLuint occlusionID = 0) {
+        if (mesh.id == 0 || set.instances == NULL || set.instances->empty())
+            return;
+
+        Draw draw;
+        draw.variant = flags;
+        draw.mesh = mesh;
+        draw.texture = texture;
+        draw.normalMap = normalMap;
+        draw.objectIndex = (GLuint)this->objects.size();
+        draw.instanceCount = (GLuint)set.instances->size();
+        draw.hasInstanceSet = true;
+        draw.instanceSet = set;
+        draw.position = sphere.center;
+        draw.bounds = bounds;
+        draw.occlusionID = occlusionID;
+        draw.conditionQuery = 0;
+
+        this->objects.push_back(parent);
+        this->draws.push_back(draw);
+        this->spheres.push_back(sphere);
+    }
+
+    // Submits a mesh (triangle list of model-space positions) that hides the objects behind it from the
+    // software occlusion culler. Ignored if no software occlusion culler is set.
+    void addOccluder(const std::vector<glm::vec3>& vertices, const glm::mat4& model) {
+        if (this->softwareCuller != NULL)
+            this->softwareCuller->addOccluder(vertices, model);
+    }
+
+    // Draws every submitted object using the shader variants; objects sharing a variant and textures form one draw call.
+    void draw(ShaderVariants& shaders) {
+        this->resetCounts();
+        if (this->draws.empty())
+            return;
+
+        const std::vector<RenderQueue::Item>& items = this->sortVisibleDraws();
+        if (items.empty()) {
+            this->issueOcclusionQueries();
+            return;
+        }
+        this->uploadObjects(items);
+
+        // Gather the indirect commands of both passes
+        bool hasDepthPrePass = this->depthShader != NULL && this->depthShader->isReady();
+        this->commands.clear();
+        this->depthGroups.clear();
+        this->itemDepthCommands.assign(items.size(), -1);
+        if (hasDepthPrePass)
+            this->buildGroups(items, canShareDepthDrawCall, isInDepthPrePass, this->depthGroups, this->itemDepthCommands);
+        this->buildGroups(items, canShareDrawCall, NULL, this->groups, this->itemCommands);
+        this->uploadCommands();
+
+        this->cullInstances(items);
+
+        // Models are opaque (alpha-cutout textures discard instead of blending)
+        GLState::setBlend(false);
+        if (hasDepthPrePass)
+            this->drawDepthPrePass(items);
+        GLState::setColorMask(true);
+        GLState::setDepthTest(true);
+
+        // Every mesh is drawn from the geometry arena
+        GLState::bindVertexArray(GeometryArena::shared().getVertexArray());
+
+        // Shader variant in use and its sampler handles
+        Shader* shader = NULL;
+        const BatchUniforms* uniforms = NULL;
+
+        for (const DrawGroup& group : this->groups) {
+            Draw& draw = this->draws[items[group.firstItem].index];
+
+            // Switch programs only when the variant changes; variants still compiling are drawn with the fallback
+            Shader& variantShader = shaders.getReady(draw.variant);
+            if (&variantShader != shader) {
+                shader = &variantShader;
+                shader->use();
+                uniforms = &this->uniforms.get(*shader);
+            }
+
+            // Pixels of the pre-pass already hold their final depth; shade only the nearest one
+            if (hasDepthPrePass && isInDepthPrePass(draw)) {
+                GLState::setDepthMask(false);
+                GLState::setDepthFunc(GL_EQUAL);
+            }
+            else {
+                GLState::setDepthMask(true);
+                GLState::setDepthFunc(GL_LESS);
+            }
+
+            // Bind the textures of the group
+            if (draw.texture.getTextureID() != 0) {
+                draw.texture.bind();
+                uniforms->tex.set(draw.texture.getTextureUnit() - GL_TEXTURE0);
+            }
+            if (draw.normalMap.getTextureID() != 0) {
+                draw.normalMap.bind();
+                uniforms->normTex.set(draw.normalMap.getTextureUnit() - GL_TEXTURE0);
+            }
+
+            // Objects whose occlusion query is in flight are skipped by the GPU if the result arrives in time
+            if (draw.conditionQuery != 0)
+                glBeginConditionalRender(draw.conditionQuery, GL_QUERY_NO_WAIT);
+
+            // Draw every mesh of the group with all of its objects
+            this->drawGroup(group);
+
+            if (draw.conditionQuery != 0)
+                glEndConditionalRender();
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        this->issueOcclusionQueries();
+    }
+
+    // Draws only the depth of every submitted object with the depth pre-pass shader (e.g. into a shadow map), into the
+    // bound framebuffer. Alpha-cutout objects are drawn solid. Nothing is drawn until the shader finished compiling.
+    void drawDepth() {
+        if (this->depthShader == NULL || !this->depthShader->isReady()) {
+            this->resetCounts();
+            return;
+        }
+
+        const std::vector<RenderQueue::Item>* items = this->prepareSinglePass();
+        if (items == NULL)
+            return;
+
+        GLState::setBlend(false);
+        this->drawDepthPrePass(*items);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        this->issueOcclusionQueries();
+    }
+
+    // Draws every submitted object in its flat color with a shader reading the position-only vertex stream (see
+    // sonar.vert), without textures or lighting. Alpha-cutout objects are drawn solid. The shader must be ready.
+    void drawFlat(Shader* flatShader) {
+        const std::vector<RenderQueue::Item>* items = this->prepareSinglePass();
+        if (items == NULL)
+            return;
+
+        GLState::setBlend(false);
+        GLState::setColorMask(true);
+        GLState::setDepthTest(true);
+        GLState::setDepthMask(true);
+        GLState::setDepthFunc(GL_LESS);
+        this->drawPositionOnly(*items, this->depthGroups, flatShader);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        this->issueOcclusionQueries();
+    }
+
+    // Sets the occlusion culler testing the objects with an occlusion ID; NULL disables occlusion culling.
+    void setOcclusionCuller(OcclusionCuller* occlusionCuller) {
+        this->occlusionCuller = occlusionCuller;
+    }
+
+    // Sets the shader of the depth pre-pass (see depth.vert); NULL disables the depth pre-pass.
+    void setDepthPrePass(Shader* depthShader) {
+        this->depthShader = depthShader;
+    }
+
+    // Sets the instance culler testing the copies of instanced groups on the GPU; NULL draws every copy of a visible group.
+    void setInstanceCuller(InstanceCuller* instanceCuller) {
+        this->instanceCuller = instanceCuller;
+    }
+
+    // Sets the software occlusion culler testing every object; NULL disables software occlusion culling.
+    void setSoftwareOcclusionCuller(SoftwareOcclusionCuller* softwareCuller) {
+        this->softwareCuller = softwareCuller;
+    }
+
+    // Returns the number of objects submitted for this frame.
+    GLuint getObjectCount() {
+        return (GLuint)this->objects.size();
+    }
+
+    // Returns the number of draw calls issued by the last draw.
+    GLuint getDrawCallCount() {
+        return this->drawCallCount;
+    }
+
+    // Returns the number of objects drawn by the last draw.
+    GLuint getVisibleCount() {
+        return this->visibleCount;
+    }
+
+    // Returns the number of objects culled by the last draw.
+    GLuint getCulledCount() {
+        return this->culledCount;
+    }
+
+    // Returns the number of objects skipped by the last draw because they were occluded.
+    GLuint getOccludedCount() {
+        return this->occludedCount;
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <map>
+#include <vector>
+
+#include "Frustum.h"
+#include "GLState.h"
+
+/******** OCCLUSION RESULTS ********/
+// Outcome of testing an object for occlusion
+enum OcclusionResult {
+    // The object is drawn
+    OCCLUSION_VISIBLE = 0,
+    // The object was hidden in its last completed test and is skipped
+    OCCLUSION_HIDDEN,
+    // The object's test is still in flight; the object is drawn with conditional rendering
+    OCCLUSION_CONDITIONAL
+};
+
+/*
+    Occlusion Culler class implementation. Tests objects for occlusion by drawing their bounding boxes
+    with GL_ANY_SAMPLES_PASSED_CONSERVATIVE queries after the opaque objects, and uses the results in
+    the following frames (temporal coherence).
+
+    Query results are only read once they are available, so the CPU never waits for the GPU. While a
+    query is still in flight, its object is drawn inside a conditional render, which lets the GPU skip it
+    if the result arrives in time. Objects that were not tested in the previous frame, or that contain
+    the camera, are always drawn.
+ */
+class OcclusionCuller {
+private:
+    // Occlusion state of a tested object, kept across frames
+    struct Entry {
+        GLuint query;
+        // The query was issued and its result was not read yet
+        bool isPending;
+        // The pending result was issued for an older view and must be ignored
+        bool isOutdated;
+        // Result of the last completed query
+        bool isVisible;
+        // Frame in which the object was last tested
+        unsigned long long lastFrame;
+    };
+
+    // Bounding box to be drawn with a query at the end of the frame
+    struct Proxy {
+        Entry* entry;
+        AABB bounds;
+    };
+
+    // Uniform handles of the proxy shader
+    struct ProxyUniforms {
+        Uniform<glm::vec3> boundsMin;
+        Uniform<glm::vec3> boundsMax;
+
+        ProxyUniforms(const Shader& shader) {
+            this->boundsMin = shader.getUniform<glm::vec3>("boundsMin");
+            this->boundsMax = shader.getUniform<glm::vec3>("boundsMax");
+        }
+    };
+    // Cached uniform handles of the proxy shader
+    UniformCache<ProxyUniforms> uniforms;
+
+    // Distance around a bounding box within which the camera counts as inside it;
+    // the near plane would clip the box's faces and hide it from its own query
+    const float CAMERA_MARGIN = 1.0f;
+
+    // Shader drawing the bounding boxes
+    Shader* proxyShader;
+    // Unit cube drawn for every bounding box
+    GLuint cubeVAO;
+    GLuint cubeVBO;
+
+    // Occlusion state of every tested object, keyed by its occlusion ID; entries never move
+    std::map<GLuint, Entry> entries;
+    // Bounding boxes to be queried this frame
+    std::vector<Proxy> proxies;
+    // Position of the camera of this frame
+    glm::vec3 cameraPos;
+    // Number of the current frame
+    unsigned long long frame;
+    // Number of objects skipped this frame
+    GLuint hiddenCount;
+
+    // Creates the unit cube (0 to 1 on every axis) drawn as a triangle list.
+    void createCube() {
+        // Corners of the unit cube, indexed by their bits (x = 1, y = 2, z = 4)
+        static const GLubyte faces[36] = {
+            0, 2, 3, 0, 3, 1, // -Z
+            4, 5, 7, 4, 7, 6, // +Z
+            0, 4, 6, 0, 6, 2, // -X
+            1, 3, 7, 1, 7, 5, // +X
+            0, 1, 5, 0, 5, 4, // -Y
+            2, 6, 7, 2, 7, 3  // +Y
+        };
+
+        std::vector<GLfloat> vertices;
+        for (GLubyte corner : faces) {
+            vertices.push_back((GLfloat)(corner & 1));
+            vertices.push_back((GLfloat)((corner >> 1) & 1));
+            vertices.push_back((GLfloat)((corner >> 2) & 1));
+        }
+
+        glGenVertexArrays(1, &this->cubeVAO);
+        glGenBuffers(1, &this->cubeVBO);
+
+        glBindVertexArray(this->cubeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, this->cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        GLState::invalidate();
+    }
+
+public:
+    // Instantiates an Occlusion Culler object drawing bounding boxes with the given shader (see proxy.vert).
+    OcclusionCuller(Shader* proxyShader) {
+        this->proxyShader = proxyShader;
+        this->cameraPos = glm::vec3(0.0f);
+        this->frame = 0;
+        this->hiddenCount = 0;
+        this->createCube();
+    }
+
+    // Starts a new frame seen from the given camera.
+    void begin(const CameraBlock& camera) {
+        this->cameraPos = camera.cameraPos;
+        this->frame++;
+        this->proxies.clear();
+        this->hiddenCount = 0;
+    }
+
+    // Tests an object by its occlusion ID (non-zero) and world-space bounding box, and queues a new query
+    // for it when needed. For OCCLUSION_CONDITIONAL, query is set to the query to render with.
+    OcclusionResult test(GLuint id, const AABB& bounds, GLuint& query) {
+        Entry& entry = this->entries[id];
+        if (entry.query == 0) {
+            glGenQueries(1, &entry.query);
+            entry.isPending = false;
+            entry.isOutdated = false;
+            entry.isVisible = true;
+            entry.lastFrame = 0;
+        }
+
+        // An object that was not tested last frame may have come into view in any way
+        bool isStale = entry.lastFrame + 1 != this->frame;
+        entry.lastFrame = this->frame;
+        if (isStale && entry.isPending)
+            entry.isOutdated = true;
+
+        // Collect the result of the last query, without waiting for it
+        if (entry.isPending) {
+            GLuint isAvailable = GL_FALSE;
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+            if (isAvailable) {
+                GLuint anySamplesPassed = GL_FALSE;
+                glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &anySamplesPassed);
+                entry.isPending = false;
+                entry.isVisible = anySamplesPassed != GL_FALSE || entry.isOutdated;
+                entry.isOutdated = false;
+            }
+        }
+
+        bool isCameraInside = glm::all(glm::greaterThanEqual(this->cameraPos, bounds.min - CAMERA_MARGIN)) &&
+            glm::all(glm::lessThanEqual(this->cameraPos, bounds.max + CAMERA_MARGIN));
+        if (isStale || isCameraInside)
+            entry.isVisible = true;
+
+        // A query still in flight decides on the GPU, unless its result no longer applies
+        if (entry.isPending) {
+            if (entry.isOutdated || isCameraInside)
+                return OCCLUSION_VISIBLE;
+
+            query = entry.query;
+            return OCCLUSION_CONDITIONAL;
+        }
+
+        // Test the object again at the end of this frame
+        if (!isCameraInside) {
+            Proxy proxy;
+            proxy.entry = &entry;
+            proxy.bounds = bounds;
+            this->proxies.push_back(proxy);
+        }
+
+        if (!entry.isVisible) {
+            this->hiddenCount++;
+            return OCCLUSION_HIDDEN;
+        }
+        return OCCLUSION_VISIBLE;
+    }
+
+    // Draws the bounding boxes queued this frame with their queries. Must be called after the occluders
+    // were drawn, so the boxes are tested against their depth.
+    void issueQueries() {
+        if (this->proxies.empty())
+            return;
+
+        // Without the proxy shader nothing can be tested; keep every object visible meanwhile
+        if (!this->proxyShader->isReady()) {
+            for (const Proxy& proxy : this->proxies)
+                proxy.entry->isVisible = true;
+            return;
+        }
+
+        // Test against the depth buffer without changing it
+        GLState::setColorMask(false);
+        GLState::setDepthTest(true);
+        GLState::setDepthMask(false);
+        GLState::setDepthFunc(GL_LEQUAL);
+        GLState::setBlend(false);
+
+        this->proxyShader->use();
+        const ProxyUniforms& uniforms = this->uniforms.get(*this->proxyShader);
+        GLState::bindVertexArray(this->cubeVAO);
+
+        for (const Proxy& proxy : this->proxies) {
+            uniforms.boundsMin.set(proxy.bounds.min);
+            uniforms.boundsMax.set(proxy.bounds.max);
+
+            glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, proxy.entry->query);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+            glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+            proxy.entry->isPending = true;
+        }
+    }
+
+    // Returns the number of objects skipped this frame because they were hidden.
+    GLuint getHiddenCount() {
+        return this->hiddenCount;
+    }
+
+    // Returns the number of queries issued this frame.
+    GLuint getQueryCount() {
+        return (GLuint)this->proxies.size();
+    }
+};
@@ -104,26 +104,29 @@ public:
 		);
 	}
 
-	// Draws the player's elements using the shader.
-	void draw(Shader shader) {
+	// Binds the player's camera being currently used to the camera uniform block, and submits the point light to the light clusters.
+	void bindToBlocks(CameraBlock& cameraBlock, LightClusters& lightClusters) {
 		// Bind the perspective camera being currently used (1st or 3rd POV)
 		// Only if current view is not in orthographic top view (bird's eye view)
 		if (this->showPlayerPOVCamera) {
 			// If first POV camera is being currently used
 			if (this->showFirstPOVCamera) {
-				this->firstPOVCamera->bindToShaderFirstPOV(shader, false);
+				this->firstPOVCamera->bindToBlockFirstPOV(cameraBlock);
 			}
 			else {
-				this->thirdPOVCamera->bindToShader(shader);
+				this->thirdPOVCamera->bindToBlock(cameraBlock);
 			}
 		}
 
-		// Bind the point light to the shader
-		this->pointLight->bindToShader(shader);
-		
+		// Bind the point light
+		this->pointLight->bindToClusters(lightClusters);
+	}
+
+	// Submits the player's model to be drawn with the other objects of the batch.
+	void submit(ObjectBatch& batch) {
 		// Draw the player's model if current camera view is not first POV or is top view
 		if (!this->showFirstPOVCamera || !this->showPlayerPOVCamera) {
-			this->model->draw(shader);
+			this->model->submit(batch);
 		}
 	}
 
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Directory where linked program binaries are stored between runs
+const char* const PROGRAM_CACHE_DIR = "ShaderCache";
+
+/*
+    Program Cache class implementation. Stores linked shader programs on disk with glGetProgramBinary()
+    and loads them with glProgramBinary() on later runs, so unchanged shaders are not compiled again.
+
+    Binaries are keyed by a hash of the shader sources and the driver string; changing either of them
+    simply misses the cache. A binary rejected by the driver is treated as a miss as well.
+ */
+class ProgramCache {
+private:
+    // Identifies a program cache file
+    static const uint32_t FILE_MAGIC = 0x43504247; // "GBPC"
+    // Version of the program cache file format
+    static const uint32_t FILE_VERSION = 1;
+
+    // Header written before the program binary
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t keyHash;
+        GLenum binaryFormat;
+        GLint binaryLength;
+    };
+
+    // Returns the FNV-1a hash of the data, continuing from the given hash.
+    static uint64_t hash(const std::string& data, uint64_t hash = 14695981039346656037ull) {
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Returns a string identifying the driver; binaries are only valid for the driver that created them.
+    static const std::string& getDriverString() {
+        static std::string driver;
+        if (driver.empty()) {
+            const char* vendor = (const char*)glGetString(GL_VENDOR);
+            const char* renderer = (const char*)glGetString(GL_RENDERER);
+            const char* version = (const char*)glGetString(GL_VERSION);
+            driver = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+        }
+        return driver;
+    }
+
+    // Returns true if the driver supports at least one program binary format.
+    static bool isSupported() {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        return formatCount > 0;
+    }
+
+    // Returns the path of the cache file for the key.
+    static std::string getCachePath(uint64_t keyHash) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)keyHash);
+        return std::string(PROGRAM_CACHE_DIR) + "/" + name;
+    }
+
+public:
+    // Returns the cache key of a program built from the given vertex and fragment sources.
+    static uint64_t computeKey(const std::string& vertexCodeStr, const std::string& fragmentCodeStr) {
+        // Separate the parts so that moving text from one source to the other changes the key
+        uint64_t key = hash(getDriverString());
+        key = hash(std::string(1, '\0') + vertexCodeStr, key);
+        key = hash(std::string(1, '\0') + fragmentCodeStr, key);
+        return key;
+    }
+
+    // Creates a program from the cached binary of the key. Returns 0 if there is no usable binary.
+    static GLuint load(uint64_t key) {
+        if (!isSupported())
+            return 0;
+
+        std::ifstream file(getCachePath(key), std::ios::binary);
+        if (!file.is_open())
+            return 0;
+
+        FileHeader header;
+        file.read((char*)&header, sizeof(header));
+        if (!file || header.magic != FILE_MAGIC || header.version != FILE_VERSION ||
+            header.keyHash != key || header.binaryLength <= 0)
+            return 0;
+
+        std::vector<char> binary(header.binaryLength);
+        file.read(binary.data(), header.binaryLength);
+        if (!file)
+            return 0;
+
+        GLuint programID = glCreateProgram();
+        glProgramBinary(programID, header.binaryFormat, binary.data(), header.binaryLength);
+
+        // Drivers reject binaries they can no longer use (e.g., after an update)
+        GLint isLinked = GL_FALSE;
+        glGetProgramiv(programID, GL_LINK_STATUS, &isLinked);
+        if (!isLinked) {
+            std::cout << "WARNING: Cached shader program was rejected by the driver, recompiling." << std::endl;
+            glDeleteProgram(programID);
+            return 0;
+        }
+
+        std::cout << "Loaded shader program from cache: " << getCachePath(key) << std::endl;
+        return programID;
+    }
+
+    // Stores the binary of a linked program under the key. The program should be linked with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Failing to store it is not an error.
+    static void store(uint64_t key, GLuint programID) {
+        if (!isSupported())
+            return;
+
+        GLint binaryLength = 0;
+        glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+        if (binaryLength <= 0)
+            return;
+
+        FileHeader header;
+        header.magic = FILE_MAGIC;
+        header.version = FILE_VERSION;
+        header.keyHash = key;
+        header.binaryFormat = 0;
+        header.binaryLength = 0;
+
+        std::vector<char> binary(binaryLength);
+        glGetProgramBinary(programID, binaryLength, &header.binaryLength, &header.binaryFormat, binary.data());
+        if (header.binaryLength <= 0)
+            return;
+
+        // Create the cache directory if it does not exist yet
+#ifdef _WIN32
+        _mkdir(PROGRAM_CACHE_DIR);
+#else
+        mkdir(PROGRAM_CACHE_DIR, 0755);
+#endif
+
+        std::ofstream file(getCachePath(key), std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "WARNING: Unable to write shader program cache: " << getCachePath(key) << std::endl;
+            return;
+        }
+
+        file.write((const char*)&header, sizeof(header));
+        file.write(binary.data(), header.binaryLength);
+    }
+};
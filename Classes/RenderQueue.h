@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/******** RENDER PASSES ********/
+// Passes are drawn in this order; the pass is the most significant part of a sort key
+enum RenderPass {
+    // Opaque geometry, drawn front-to-back within a batch
+    RENDER_PASS_OPAQUE = 0,
+    // Opaque geometry with alpha-cutout pixels; drawn after the rest, as it cannot take part in a depth pre-pass
+    RENDER_PASS_ALPHA_CUTOUT = 1
+};
+
+/*
+    Render Queue class implementation. Orders draw items by a 64-bit sort key, so that items sharing a
+    pass, program, material, and mesh end up next to each other and can be submitted with minimal state
+    changes. Items are radix-sorted once per frame.
+
+    Sort key layout, from the most to the least significant bits:
+    - pass (4 bits)
+    - program permutation (8 bits)
+    - material (16 bits)
+    - mesh (16 bits)
+    - quantized depth (16 bits); nearer items first
+    - unused (4 bits)
+ */
+class RenderQueue {
+public:
+    // A draw item; the index refers to the caller's own list of draws
+    struct Item {
+        uint64_t key;
+        uint32_t index;
+    };
+
+private:
+    // Items pushed for this frame; sorted by sort()
+    std::vector<Item> items;
+    // Scratch space for the radix sort
+    std::vector<Item> scratch;
+
+public:
+    // Builds a sort key. Material and mesh values are truncated to their bits; equal keys only
+    // mean the items are likely to share state, so callers still compare the actual state.
+    static uint64_t makeKey(RenderPass pass, uint32_t program, uint32_t material, uint32_t mesh, float depth, float maxDepth) {
+        // Quantize the depth into 16 bits, clamping anything outside [0, maxDepth]
+        float normalizedDepth = maxDepth > 0.0f ? depth / maxDepth : 0.0f;
+        normalizedDepth = normalizedDepth < 0.0f ? 0.0f : (normalizedDepth > 1.0f ? 1.0f : normalizedDepth);
+        uint64_t quantizedDepth = (uint64_t)(normalizedDepth * 65535.0f);
+
+        return ((uint64_t)(pass & 0xF) << 60) |
+            ((uint64_t)(program & 0xFF) << 52) |
+            ((uint64_t)(material & 0xFFFF) << 36) |
+            ((uint64_t)(mesh & 0xFFFF) << 20) |
+            (quantizedDepth << 4);
+    }
+
+    // Removes every item.
+    void clear() {
+        this->items.clear();
+    }
+
+    // Adds an item to the queue.
+    void push(uint64_t key, uint32_t index) {
+        Item item;
+        item.key = key;
+        item.index = index;
+        this->items.push_back(item);
+    }
+
+    // Sorts the items by their key with an LSD radix sort (8 bits per digit). Stable, so items with
+    // equal keys keep their push order. Digits that are the same for every item are skipped.
+    void sort() {
+        const size_t count = this->items.size();
+        if (count < 2)
+            return;
+
+        // Count every digit of every key in a single pass
+        static const int DIGIT_COUNT = 8;
+        size_t histograms[DIGIT_COUNT][256] = {};
+        for (const Item& item : this->items) {
+            for (int digit = 0; digit < DIGIT_COUNT; digit++)
+                histograms[digit][(item.key >> (digit * 8)) & 0xFF]++;
+        }
+
+        this->scratch.resize(count);
+        for (int digit = 0; digit < DIGIT_COUNT; digit++) {
+            size_t* histogram = histograms[digit];
+
+            // Every item has the same digit; this pass would not move anything
+            if (histogram[(this->items[0].key >> (digit * 8)) & 0xFF] == count)
+                continue;
+
+            // Turn the counts into starting offsets
+            size_t offset = 0;
+            for (int i = 0; i < 256; i++) {
+                size_t digitCount = histogram[i];
+                histogram[i] = offset;
+                offset += digitCount;
+            }
+
+            for (const Item& item : this->items)
+                this->scratch[histogram[(item.key >> (digit * 8)) & 0xFF]++] = item;
+            this->items.swap(this->scratch);
+        }
+    }
+
+    // Returns the items; in key order after sort().
+    const std::vector<Item>& getItems() const {
+        return this->items;
+    }
+
+    // Returns the number of items.
+    size_t size() const {
+        return this->items.size();
+    }
+};
@@ -2,13 +2,170 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
+#include <functional>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "GLState.h"
+#include "ProgramCache.h"
+
+/*
+    Uniform Values class implementation. Shadows the last value written to each uniform location of a
+    shader program, so writing an unchanged value can be skipped.
+ */
+class UniformValues {
+private:
+    // Bytes of the last value written to each location (empty if none was written yet)
+    std::vector<std::vector<unsigned char>> values;
+
+public:
+    // Remembers the value written to a location. Returns true if it differs from the last one written.
+    bool update(GLint location, const void* data, size_t size) {
+        if (location >= (GLint)this->values.size())
+            this->values.resize(location + 1);
+
+        std::vector<unsigned char>& value = this->values[location];
+        if (value.size() == size && memcmp(value.data(), data, size) == 0)
+            return false;
+
+        value.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        return true;
+    }
+
+    // Forgets every written value; used when the program is rebuilt.
+    void clear() {
+        this->values.clear();
+    }
+};
+
+/*
+    Uniform class implementation. A typed handle to a shader uniform whose location was resolved once,
+    so setting its value never has to look up the uniform by name.
+ */
+template <typename T>
+class Uniform {
+private:
+    // Location of the uniform within its shader program (-1 if the uniform is not active)
+    GLint location;
+    // Last values written to the uniforms of the shader program (may be NULL)
+    UniformValues* values;
+
+    // Returns true if the uniform is active and the value differs from the one it holds already.
+    bool needsUpdate(const T& value) const {
+        if (this->location < 0)
+            return false;
+        return this->values == NULL || this->values->update(this->location, &value, sizeof(T));
+    }
+
+public:
+    // Instantiates a Uniform handle.
+    Uniform(GLint location = -1, UniformValues* values = NULL) {
+        this->location = location;
+        this->values = values;
+    }
+
+    // Set the value of this uniform within the shader currently in use. Inactive uniforms and unchanged values are skipped.
+    void set(const T& value) const;
+
+    // Returns true if the uniform is active within its shader program.
+    bool isValid() const {
+        return this->location >= 0;
+    }
+
+    // Returns the location of the uniform.
+    GLint getLocation() const {
+        return this->location;
+    }
+};
+
+// Set a boolean uniform value.
+template <>
+inline void Uniform<bool>::set(const bool& value) const {
+    if (this->needsUpdate(value))
+        glUniform1i(this->location, (int)value);
+}
+
+// Set an integer uniform value.
+template <>
+inline void Uniform<int>::set(const int& value) const {
+    if (this->needsUpdate(value))
+        glUniform1i(this->location, value);
+}
+
+// Set an ivec2 uniform value.
+template <>
+inline void Uniform<glm::ivec2>::set(const glm::ivec2& value) const {
+    if (this->needsUpdate(value))
+        glUniform2iv(this->location, 1, &value[0]);
+}
+
+// Set a float uniform value.
+template <>
+inline void Uniform<float>::set(const float& value) const {
+    if (this->needsUpdate(value))
+        glUniform1f(this->location, value);
+}
+
+// Set a vec2 uniform value.
+template <>
+inline void Uniform<glm::vec2>::set(const glm::vec2& value) const {
+    if (this->needsUpdate(value))
+        glUniform2fv(this->location, 1, &value[0]);
+}
+
+// Set a vec3 uniform value.
+template <>
+inline void Uniform<glm::vec3>::set(const glm::vec3& value) const {
+    if (this->needsUpdate(value))
+        glUniform3fv(this->location, 1, &value[0]);
+}
+
+// Set a vec4 uniform value.
+template <>
+inline void Uniform<glm::vec4>::set(const glm::vec4& value) const {
+    if (this->needsUpdate(value))
+        glUniform4fv(this->location, 1, &value[0]);
+}
+
+// Set a 2x2 matrix uniform value.
+template <>
+inline void Uniform<glm::mat2>::set(const glm::mat2& value) const {
+    if (this->needsUpdate(value))
+        glUniformMatrix2fv(this->location, 1, GL_FALSE, &value[0][0]);
+}
+
+// Set a 3x3 matrix uniform value.
+template <>
+inline void Uniform<glm::mat3>::set(const glm::mat3& value) const {
+    if (this->needsUpdate(value))
+        glUniformMatrix3fv(this->location, 1, GL_FALSE, &value[0][0]);
+}
+
+// Set a 4x4 matrix uniform value.
+template <>
+inline void Uniform<glm::mat4>::set(const glm::mat4& value) const {
+    if (this->needsUpdate(value))
+        glUniformMatrix4fv(this->location, 1, GL_FALSE, &value[0][0]);
+}
 
 /*
     Shader class implementation. Holds every shader-related functionality.
+
+    Programs are compiled asynchronously: the constructor only submits the sources to the driver, and
+    isReady() polls for completion (through GL_KHR_parallel_shader_compile, if available) without blocking.
+    Using the shader before it is ready waits for the program to finish.
+
+    A shader built from a single compute shader file has no fragment shader file; its program is
+    dispatched instead of drawn with.
     
     Adapted from: https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader_m.h
  */
@@ -16,10 +173,82 @@ class Shader {
 private:
     // Unique identifier for this shader
     unsigned int shaderProgramID;
+    // Path to the vertex shader file (or the compute shader file)
+    std::string vertPath;
+    // Path to the fragment shader file (empty for compute shaders)
+    std::string fragPath;
+    // Preprocessor defines injected into both shader sources
+    std::vector<std::string> defines;
+    // Locations of every active uniform, reflected once after linking
+    std::unordered_map<std::string, GLint> uniformLocations;
+    // Last values written to the uniforms of the linked program; stored as a pointer so handles stay valid if the shader moves
+    std::unique_ptr<UniformValues> uniformValues;
+    // Revision of the linked program; unique across all shaders and changes whenever the program is rebuilt
+    unsigned int programRevision;
+
+    // A program submitted to the driver that may still be compiling
+    struct PendingProgram {
+        // The program being linked (0 if none)
+        GLuint programID = 0;
+        // The shaders being compiled (0 if the program was loaded from the program cache)
+        GLuint vertexShader = 0;
+        GLuint fragmentShader = 0;
+        // Program cache key of the sources
+        uint64_t cacheKey = 0;
+    };
+    // Program submitted by the constructor that was not checked yet
+    PendingProgram pendingProgram;
+
+    // Returns a new unique program revision.
+    static unsigned int nextProgramRevision() {
+        static unsigned int revision = 0;
+        return ++revision;
+    }
+
+    // Query every active uniform of the linked program and store its location.
+    void reflectUniforms() {
+        this->uniformLocations.clear();
+        this->uniformValues->clear();
+        this->programRevision = nextProgramRevision();
+
+        if (this->shaderProgramID == 0)
+            return;
+
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(this->shaderProgramID, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(this->shaderProgramID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::vector<GLchar> nameBuffer(maxNameLength + 1);
+        for (GLint i = 0; i < uniformCount; i++) {
+            GLsizei nameLength = 0;
+            GLint arraySize = 0;
+            GLenum type;
+            glGetActiveUniform(this->shaderProgramID, i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+            // Uniforms that belong to a uniform block have no location
+            std::string name(nameBuffer.data(), nameLength);
+            GLint location = glGetUniformLocation(this->shaderProgramID, name.c_str());
+            if (location < 0)
+                continue;
+            this->uniformLocations[name] = location;
+
+            // Arrays are reported as "name[0]"; register the plain name and every other element as well
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string baseName = name.substr(0, name.size() - 3);
+                this->uniformLocations[baseName] = location;
+
+                for (GLint j = 1; j < arraySize; j++) {
+                    std::string elementName = baseName + "[" + std::to_string(j) + "]";
+                    this->uniformLocations[elementName] = glGetUniformLocation(this->shaderProgramID, elementName.c_str());
+                }
+            }
+        }
+    }
 
     /******** UTILITY FUNCTIONS ********/
-    // Check for shader compilation errors.
-    void checkCompileErrors(GLuint shader, std::string type) {
+    // Check for shader compilation errors. Returns true if there are none.
+    bool checkCompileErrors(GLuint shader, std::string type) {
         GLint success;
         GLchar infoLog[1024];
         if (type != "PROGRAM") {
@@ -36,14 +265,169 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "-----------\n" << std::endl;
             }
         }
+        return success;
+    }
+
+    // Inserts the defines of this shader right after the #version line of the source.
+    std::string injectDefines(const std::string& codeStr) {
+        if (this->defines.empty())
+            return codeStr;
+
+        // The #version directive must stay first; everything else may follow it
+        size_t versionPos = codeStr.find("#version");
+        size_t insertPos = versionPos == std::string::npos ? 0 : codeStr.find('\n', versionPos);
+        if (insertPos == std::string::npos)
+            return codeStr;
+        if (versionPos != std::string::npos)
+            insertPos++;
+
+        std::string defineStr;
+        for (const std::string& define : this->defines)
+            defineStr += "#define " + define + "\n";
+
+        // Keep reported line numbers matching the file
+        int nextLine = 1 + (int)std::count(codeStr.begin(), codeStr.begin() + insertPos, '\n');
+        defineStr += "#line " + std::to_string(nextLine) + "\n";
+
+        return codeStr.substr(0, insertPos) + defineStr + codeStr.substr(insertPos);
+    }
+
+    // Read the vertex and fragment shader files. Returns true if both were read successfully.
+    bool readShaderFiles(std::string& vertexCodeStr, std::string& fragmentCodeStr) {
+        return Shader::readShaderFiles(this->vertPath, this->fragPath, vertexCodeStr, fragmentCodeStr);
+    }
+
+    // Submit the shader program to be compiled and linked, or load it from the program cache if it was built before.
+    // Nothing is checked yet so that the driver can compile in the background; see finishProgram().
+    PendingProgram submitProgram(const std::string& vertexFileStr, const std::string& fragmentFileStr) {
+        PendingProgram pending;
+
+        // Specialize the sources first; the defines are part of the program cache key as well
+        std::string vertexCodeStr = this->injectDefines(vertexFileStr);
+        std::string fragmentCodeStr = this->injectDefines(fragmentFileStr);
+
+        // Skip compiling if the same sources were linked by this driver before
+        pending.cacheKey = ProgramCache::computeKey(vertexCodeStr, fragmentCodeStr);
+        pending.programID = ProgramCache::load(pending.cacheKey);
+        if (pending.programID != 0)
+            return pending;
+
+        // Convert shader file content
+        const char* vertexCode = vertexCodeStr.c_str();
+        const char* fragmentCode = fragmentCodeStr.c_str();
+
+        // A compute shader is the only stage of its program
+        if (this->isCompute()) {
+            GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(computeShader, 1, &vertexCode, NULL);
+            glCompileShader(computeShader);
+
+            GLuint programID = glCreateProgram();
+            glAttachShader(programID, computeShader);
+            glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glLinkProgram(programID);
+
+            pending.programID = programID;
+            pending.vertexShader = computeShader;
+            return pending;
+        }
+
+        // Create a Vertex Shader
+        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        // Assign the Vertex Shader file to the Vertex Shader
+        glShaderSource(vertexShader, 1, &vertexCode, NULL);
+        // Compile the Vertex Shader
+        glCompileShader(vertexShader);
+
+        // Create a Fragment Shader
+        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        // Assign the Fragment Shader file to the Fragment Shader
+        glShaderSource(fragmentShader, 1, &fragmentCode, NULL);
+        // Compile the Fragment Shader
+        glCompileShader(fragmentShader);
+
+        // Create the shader program
+        GLuint programID = glCreateProgram();
+        glAttachShader(programID, vertexShader);
+        glAttachShader(programID, fragmentShader);
+        // Allow retrieving the linked binary for the program cache
+        glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(programID);
+
+        pending.programID = programID;
+        pending.vertexShader = vertexShader;
+        pending.fragmentShader = fragmentShader;
+        return pending;
+    }
+
+    // Returns true if the driver finished compiling and linking the program, so checking it will not block.
+    static bool isProgramComplete(const PendingProgram& pending) {
+        // Programs loaded from the cache are complete; without the extension, completion cannot be polled
+        if (pending.vertexShader == 0 || !GLAD_GL_KHR_parallel_shader_compile)
+            return true;
+
+        GLint isComplete = GL_FALSE;
+        glGetProgramiv(pending.programID, GL_COMPLETION_STATUS_KHR, &isComplete);
+        return isComplete == GL_TRUE;
+    }
+
+    // Check the submitted shader program, waiting for it if needed. Returns its unique identifier, or 0 if compiling or linking failed.
+    GLuint finishProgram(const PendingProgram& pending) {
+        // Programs loaded from the cache were checked when loaded
+        if (pending.vertexShader == 0)
+            return pending.programID;
+
+        // Check for compilation errors
+        bool isCompiled = checkCompileErrors(pending.vertexShader, this->isCompute() ? "COMPUTE" : "VERTEX");
+        if (pending.fragmentShader != 0)
+            isCompiled = checkCompileErrors(pending.fragmentShader, "FRAGMENT") && isCompiled;
+        // Check for linking errors
+        bool isLinked = checkCompileErrors(pending.programID, "PROGRAM");
+
+        // Delete shaders since they are linked already
+        glDeleteShader(pending.vertexShader);
+        if (pending.fragmentShader != 0)
+            glDeleteShader(pending.fragmentShader);
+
+        // Discard the program if any of the steps failed
+        if (!isCompiled || !isLinked) {
+            glDeleteProgram(pending.programID);
+            return 0;
+        }
+
+        ProgramCache::store(pending.cacheKey, pending.programID);
+        return pending.programID;
+    }
+
+    // Compile and link the shader program, waiting for it to finish. Returns its unique identifier, or 0 if compiling or linking failed.
+    GLuint buildProgram(const std::string& vertexCodeStr, const std::string& fragmentCodeStr) {
+        return this->finishProgram(this->submitProgram(vertexCodeStr, fragmentCodeStr));
+    }
+
+    // Returns true if the program is built from a compute shader.
+    bool isCompute() const {
+        return this->fragPath.empty();
+    }
+
+    // Swaps in the submitted program once it is checked.
+    void finishPendingProgram() {
+        GLuint programID = this->finishProgram(this->pendingProgram);
+        this->pendingProgram = PendingProgram();
+
+        if (programID == 0) {
+            std::cout << "ERROR: Unable to build shader " << this->vertPath << ", " << this->fragPath << std::endl;
+            return;
+        }
+
+        this->shaderProgramID = programID;
+        this->reflectUniforms();
     }
 
 public:
-    // Instantiates a Shader object.
-    Shader(const char* vertPath, const char* fragPath) {
+    // Read a vertex and fragment shader file, or only the first file if there is no fragment shader file.
+    // Returns true if the files were read successfully.
+    static bool readShaderFiles(const std::string& vertPath, const std::string& fragPath, std::string& vertexCodeStr, std::string& fragmentCodeStr) {
         // Initialize variables for loading of shader files
-        std::string vertexCodeStr;
-        std::string fragmentCodeStr;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
 
@@ -55,14 +439,16 @@ public:
             std::cout << "Loading Shader files..." << std::endl;
             // Open files
             vShaderFile.open(vertPath);
-            fShaderFile.open(fragPath);
             std::stringstream vShaderStream, fShaderStream;
             // Read file's buffer contents into streams
             vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
             // Close file handlers
             vShaderFile.close();
-            fShaderFile.close();
+            if (!fragPath.empty()) {
+                fShaderFile.open(fragPath);
+                fShaderStream << fShaderFile.rdbuf();
+                fShaderFile.close();
+            }
             // Convert stream into string
             vertexCodeStr = vShaderStream.str();
             fragmentCodeStr = fShaderStream.str();
@@ -70,108 +456,318 @@ public:
         // If there's an error in reading the file
         catch (std::ifstream::failure& e) {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
+            return false;
         }
 
         std::cout << "Loaded Shader files successfully! \n" << std::endl;
+        return true;
+    }
 
-        // Convert shader file content
-        const char* vertexCode = vertexCodeStr.c_str();
-        const char* fragmentCode = fragmentCodeStr.c_str();
+    // Instantiates a Shader object. The defines are injected into both shader sources.
+    Shader(const char* vertPath, const char* fragPath, const std::vector<std::string>& defines = std::vector<std::string>()) {
+        this->vertPath = vertPath;
+        this->fragPath = fragPath;
+        this->defines = defines;
+        this->uniformValues.reset(new UniformValues());
 
-        // Create a Vertex Shader
-        GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        // Assign the Vertex Shader file to the Vertex Shader
-        glShaderSource(vertexShader, 1, &vertexCode, NULL);
-        // Compile the Vertex Shader
-        glCompileShader(vertexShader);
-        // Check for compilation errors
-        checkCompileErrors(vertexShader, "VERTEX");
+        // Load the shader files, then submit them to be compiled into a program
+        std::string vertexCodeStr;
+        std::string fragmentCodeStr;
+        this->readShaderFiles(vertexCodeStr, fragmentCodeStr);
+        this->shaderProgramID = 0;
+        this->pendingProgram = this->submitProgram(vertexCodeStr, fragmentCodeStr);
+        this->reflectUniforms();
+    }
 
-        // Create a Fragment Shader
-        GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        // Assign the Fragment Shader file to the Fragment Shader
-        glShaderSource(fragmentShader, 1, &fragmentCode, NULL);
-        // Compile the Fragment Shader
-        glCompileShader(fragmentShader);
-        // Check for compilation errors
-        checkCompileErrors(vertexShader, "FRAGMENT");
+    // Instantiates a compute Shader object. The defines are injected into the shader source.
+    explicit Shader(const char* compPath, const std::vector<std::string>& defines = std::vector<std::string>())
+        : Shader(compPath, "", defines) {
+    }
 
-        // Create the shader program
-        shaderProgramID = glCreateProgram();
-        glAttachShader(shaderProgramID, vertexShader);
-        glAttachShader(shaderProgramID, fragmentShader);
-        glLinkProgram(shaderProgramID);
-        // Check for compilation errors
-        checkCompileErrors(shaderProgramID, "PROGRAM");
+    // Returns true if the program finished building successfully. Never blocks on the driver.
+    bool isReady() {
+        if (this->pendingProgram.programID != 0 && isProgramComplete(this->pendingProgram))
+            this->finishPendingProgram();
 
-        // Delete shaders since they are linked already
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
+        return this->shaderProgramID != 0;
+    }
+
+    // Waits for the program to finish building. Returns true if it was built successfully.
+    bool waitUntilReady() {
+        if (this->pendingProgram.programID != 0)
+            this->finishPendingProgram();
+
+        return this->shaderProgramID != 0;
+    }
+
+    /******** HOT-RELOAD FUNCTIONS ********/
+    // Re-reads the shader files. Returns the step that compiles and swaps in the new program, or an empty function if reading failed.
+    std::function<void()> prepareReload() {
+        std::string vertexCodeStr;
+        std::string fragmentCodeStr;
+        if (!this->readShaderFiles(vertexCodeStr, fragmentCodeStr))
+            return nullptr;
+
+        // Compiling must happen on the OpenGL thread
+        return [this, vertexCodeStr, fragmentCodeStr]() { this->rebuild(vertexCodeStr, fragmentCodeStr); };
+    }
+
+    // Rebuilds the program from new shader sources. Must be called from the OpenGL thread.
+    // Returns true if the new program was swapped in; if building fails, the old program is kept.
+    bool rebuild(const std::string& vertexCodeStr, const std::string& fragmentCodeStr) {
+        // The initial program must be settled first so it is not swapped in over the new one
+        this->waitUntilReady();
+
+        GLuint programID = this->buildProgram(vertexCodeStr, fragmentCodeStr);
+        if (programID == 0) {
+            std::cout << "ERROR: Unable to rebuild shader, keeping the old program." << std::endl;
+            return false;
+        }
+
+        glDeleteProgram(this->shaderProgramID);
+        this->shaderProgramID = programID;
+
+        // Locations may have moved; cached handles are re-resolved through the new revision
+        this->reflectUniforms();
+        return true;
+    }
+
+    // Watches the shader files so the program is hot-reloaded when either of them changes on disk.
+    // The shader must not be moved or copied afterwards.
+    void watchAssets(AssetWatcher& watcher) {
+        watcher.watch(this->vertPath, [this]() { return this->prepareReload(); });
+        if (!this->isCompute())
+            watcher.watch(this->fragPath, [this]() { return this->prepareReload(); });
+    }
+
+    // Use this shader; waits for the program if it is still being built.
+    void use() {
+        this->waitUntilReady();
+        GLState::useProgram(shaderProgramID);
+    }
+
+    // Returns the unique identifier of the linked program.
+    unsigned int getProgramID() const {
+        return this->shaderProgramID;
+    }
+
+    // Returns the revision of the linked program.
+    unsigned int getProgramRevision() const {
+        return this->programRevision;
+    }
+
+    // Returns the location of an active uniform, or -1 if the uniform is not active.
+    GLint getUniformLocation(const std::string& name) const {
+        auto uniform = this->uniformLocations.find(name);
+        return uniform == this->uniformLocations.end() ? -1 : uniform->second;
     }
 
-    // Use this shader.
-    void use() const {
-        glUseProgram(shaderProgramID);
+    // Returns a typed handle to a uniform. Resolve handles once and reuse them instead of setting uniforms by name.
+    template <typename T>
+    Uniform<T> getUniform(const std::string& name) const {
+        return Uniform<T>(getUniformLocation(name), this->uniformValues.get());
     }
 
     /******** UTILITY FUNCTIONS ********/
     // Set a boolean variable value within the shader.
     void setBool(const std::string& name, bool value) const {
-        glUniform1i(glGetUniformLocation(shaderProgramID, name.c_str()), (int)value);
+        getUniform<bool>(name).set(value);
     }
 
     // Set an integer variable value within the shader.
     void setInt(const std::string& name, int value) const {
-        glUniform1i(glGetUniformLocation(shaderProgramID, name.c_str()), value);
+        getUniform<int>(name).set(value);
     }
 
     // Set a float variable value within the shader.
     void setFloat(const std::string& name, float value) const {
-        glUniform1f(glGetUniformLocation(shaderProgramID, name.c_str()), value);
+        getUniform<float>(name).set(value);
     }
 
     // Set a vec2 variable value within the shader.
     void setVec2(const std::string& name, const glm::vec2& value) const {
-        glUniform2fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, &value[0]);
+        getUniform<glm::vec2>(name).set(value);
     }
 
     // Set a vec2 variable value within the shader with separate x and y values.
     void setVec2(const std::string& name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(shaderProgramID, name.c_str()), x, y);
+        getUniform<glm::vec2>(name).set(glm::vec2(x, y));
     }
 
     // Set a vec3 variable value within the shader.
     void setVec3(const std::string& name, const glm::vec3& value) const {
-        glUniform3fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, &value[0]);
+        getUniform<glm::vec3>(name).set(value);
     }
 
     // Set a vec3 variable value within the shader with separate x, y, and z values.
     void setVec3(const std::string& name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(shaderProgramID, name.c_str()), x, y, z);
+        getUniform<glm::vec3>(name).set(glm::vec3(x, y, z));
     }
 
     // Set a vec4 variable value within the shader.
     void setVec4(const std::string& name, const glm::vec4& value) const {
-        glUniform4fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, &value[0]);
+        getUniform<glm::vec4>(name).set(value);
     }
 
     // Set a vec4 variable value within the shader with separate x, y, z, and w values.
     void setVec4(const std::string& name, float x, float y, float z, float w) const {
-        glUniform4f(glGetUniformLocation(shaderProgramID, name.c_str()), x, y, z, w);
+        getUniform<glm::vec4>(name).set(glm::vec4(x, y, z, w));
     }
 
     // Set a 2x2 matrix value within the shader.
     void setMat2(const std::string& name, const glm::mat2& mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        getUniform<glm::mat2>(name).set(mat);
     }
 
     // Set a 3x3 matrix value within the shader.
     void setMat3(const std::string& name, const glm::mat3& mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        getUniform<glm::mat3>(name).set(mat);
     }
 
     // Set a 4x4 matrix value within the shader.
     void setMat4(const std::string& name, const glm::mat4& mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgramID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        getUniform<glm::mat4>(name).set(mat);
+    }
+};
+
+/*
+    Uniform Cache class implementation. Holds a set of uniform handles per shader program, so the handles are
+    resolved once per program (and again after a hot-reload) instead of on every draw.
+
+    The Handles type must be constructible from a Shader.
+ */
+template <typename Handles>
+class UniformCache {
+private:
+    // Resolved handles of a shader, with the revision of the program they were resolved for
+    struct Entry {
+        const Shader* shader;
+        unsigned int revision;
+        Handles handles;
+    };
+
+    // One entry per shader; rebuilt programs replace the handles of their shader's entry
+    std::vector<Entry> entries;
+
+public:
+    // Returns the handles for the given shader, resolving them on first use and after the program is rebuilt.
+    const Handles& get(const Shader& shader) {
+        unsigned int revision = shader.getProgramRevision();
+        for (Entry& entry : this->entries) {
+            if (entry.shader != &shader)
+                continue;
+
+            if (entry.revision != revision) {
+                entry.revision = revision;
+                entry.handles = Handles(shader);
+            }
+            return entry.handles;
+        }
+
+        this->entries.push_back(Entry{ &shader, revision, Handles(shader) });
+        return this->entries.back().handles;
+    }
+};
+
+/*
+    Shader Variants class implementation. Holds specialized versions (permutations) of a shader, so that
+    features are selected at compile time instead of with runtime uniform branches.
+
+    Each bit of a variant key enables one preprocessor define. Variants are built the first time they are
+    requested, or ahead of time with build(). A fallback shader stands in for variants that are still compiling.
+ */
+class ShaderVariants {
+private:
+    // Path to the vertex shader file
+    std::string vertPath;
+    // Path to the fragment shader file
+    std::string fragPath;
+    // Define enabled by each bit of a variant key
+    std::vector<std::string> defineNames;
+    // Built variants, keyed by their variant key; stored as pointers so they never move
+    std::map<unsigned int, std::unique_ptr<Shader>> variants;
+    // Shader used in place of variants that are not ready yet (may be NULL)
+    Shader* fallback;
+
+public:
+    // Instantiates a Shader Variants object; bit i of a variant key enables defineNames[i].
+    // The fallback shader must be compatible with every variant's inputs and is waited for right away.
+    ShaderVariants(const char* vertPath, const char* fragPath, const std::vector<std::string>& defineNames, Shader* fallback = NULL) {
+        this->vertPath = vertPath;
+        this->fragPath = fragPath;
+        this->defineNames = defineNames;
+        this->fallback = fallback;
+
+        if (this->fallback != NULL)
+            this->fallback->waitUntilReady();
+    }
+
+    // Returns the variant of the key, building it if it was not used before.
+    Shader& get(unsigned int key) {
+        auto variant = this->variants.find(key);
+        if (variant != this->variants.end())
+            return *variant->second;
+
+        std::vector<std::string> defines;
+        for (size_t i = 0; i < this->defineNames.size(); i++) {
+            if (key & (1u << i))
+                defines.push_back(this->defineNames[i]);
+        }
+
+        std::unique_ptr<Shader>& shader = this->variants[key];
+        shader.reset(new Shader(this->vertPath.c_str(), this->fragPath.c_str(), defines));
+        return *shader;
+    }
+
+    // Returns the variant of the key if it finished building, otherwise the fallback shader (or the variant, if there is none).
+    // Requesting a variant starts building it; this never blocks on the driver.
+    Shader& getReady(unsigned int key) {
+        Shader& variant = this->get(key);
+        if (variant.isReady() || this->fallback == NULL || !this->fallback->isReady())
+            return variant;
+
+        return *this->fallback;
+    }
+
+    // Submits the variants of the keys to be built ahead of their first use.
+    void build(const std::vector<unsigned int>& keys) {
+        for (unsigned int key : keys)
+            this->get(key);
+    }
+
+    // Returns true if every variant requested so far finished building. Never blocks on the driver.
+    bool isReady() {
+        for (auto& variant : this->variants) {
+            if (!variant.second->isReady())
+                return false;
+        }
+        return true;
+    }
+
+    // Returns the number of built variants.
+    size_t getVariantCount() const {
+        return this->variants.size();
+    }
+
+    /******** HOT-RELOAD FUNCTIONS ********/
+    // Re-reads the shader files. Returns the step that rebuilds every built variant, or an empty function if reading failed.
+    std::function<void()> prepareReload() {
+        std::string vertexCodeStr;
+        std::string fragmentCodeStr;
+        if (!Shader::readShaderFiles(this->vertPath, this->fragPath, vertexCodeStr, fragmentCodeStr))
+            return nullptr;
+
+        // Variants built after this point read the new files themselves
+        return [this, vertexCodeStr, fragmentCodeStr]() {
+            for (auto& variant : this->variants)
+                variant.second->rebuild(vertexCodeStr, fragmentCodeStr);
+        };
+    }
+
+    // Watches the shader files so every variant is hot-reloaded when either of them changes on disk.
+    // The variants must not be moved or copied afterwards.
+    void watchAssets(AssetWatcher& watcher) {
+        watcher.watch(this->vertPath, [this]() { return this->prepareReload(); });
+        watcher.watch(this->fragPath, [this]() { return this->prepareReload(); });
     }
-};
\ No newline at end of file
+};
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "GLState.h"
+#include "Light.h"
+#include "ObjectBatch.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+
+/******** SHADOW ATLAS TEXTURE UNIT ********/
+// Must match the binding layout qualifier of shadowAtlas in main.frag
+const GLenum SHADOW_ATLAS_UNIT = GL_TEXTURE14;
+
+/*
+    Shadow Maps class implementation. Renders the shadows of the directional light and of one point light
+    (the submarine's) into a depth atlas sampled by the model shader (see main.frag): one tile for the
+    directional light, around a focus point, and one tile per cube face of the point light.
+
+    Casters that have not moved for a while are static. They are rendered into a second, persistent atlas,
+    whose tiles are only rendered again when their light moves or the set of static casters changes. The
+    sampled atlas is a copy of the static one with the moving casters drawn on top. While neither the
+    lights nor the casters move, nothing is rendered or copied at all.
+ */
+class ShadowMaps {
+private:
+    // A model casting shadows
+    struct Caster {
+        Model* model;
+        // Transformation of the model in the last frame
+        glm::mat4 transform;
+        // Number of frames since the model last moved
+        int stillFrames;
+        // Flag to determine if the model is drawn on top of the static tiles instead of into them
+        bool isDynamic;
+    };
+
+    // A light's view rendered into a tile of the atlas
+    struct ShadowView {
+        // Camera of the light
+        CameraBlock camera;
+        // Bottom-left corner and size of the tile in the atlas (in texels)
+        int x;
+        int y;
+        int size;
+        // Flag to determine if the static tile holds the static casters of the current camera
+        bool isStaticValid;
+        // Flag to determine if moving casters were drawn into the tile last frame
+        bool hasDynamicCasters;
+    };
+
+    // Size of the directional light's tile, and of each point light face's tile (in texels)
+    const int DIRECTIONAL_TILE_SIZE = 2048;
+    const int POINT_TILE_SIZE = 1024;
+    // Width of the area around the focus point the directional light's tile covers
+    const float DIRECTIONAL_EXTENT = 400.0f;
+    // Step the focus point is snapped to; the directional tile is only rendered again when the snapped point changes
+    const float DIRECTIONAL_SNAP = 50.0f;
+    // Depth range of the directional light's view, centered on the focus point
+    const float DIRECTIONAL_DEPTH = 4000.0f;
+    // Near and farthest far plane of the point light's faces; a light without attenuation reaches infinitely far
+    const float POINT_NEAR = 0.5f;
+    const float POINT_MAX_FAR = 1000.0f;
+    // Number of still frames after which a caster counts as static
+    const int SETTLE_FRAMES = 30;
+    // Depth offset of the casters, against shadow acne
+    const float POLYGON_OFFSET_FACTOR = 2.0f;
+    const float POLYGON_OFFSET_UNITS = 4.0f;
+    // Normal offset of a lookup, in texels
+    const float NORMAL_OFFSET_TEXELS = 1.5f;
+
+    // Lights casting the shadows
+    DirectionalLight* directionalLight;
+    PointLight* pointLight;
+    // Camera buffer of the frame, bound again once the shadows are rendered
+    UniformBuffer<CameraBlock>* cameraBuffer;
+    // Shader drawing the casters' depth
+    Shader* depthShader;
+    // Batch drawing the casters into the tiles; shares the depth pre-pass shader and the instance culler
+    ObjectBatch batch;
+
+    // Models casting shadows
+    std::vector<Caster> casters;
+    // Directional light's view, then the point light's faces (+X, -X, +Y, -Y, +Z, -Z)
+    std::vector<ShadowView> views;
+    // Point the directional light's tile is centered on
+    glm::vec3 focus;
+
+    // Depth atlas sampled by the model shader, and the atlas of the static casters, with their framebuffers
+    GLuint atlas;
+    GLuint staticAtlas;
+    GLuint framebuffer;
+    GLuint staticFramebuffer;
+    int atlasWidth;
+    int atlasHeight;
+
+    // Shadow views in the atlas, for the model shader
+    ShadowBlock shadowBlock;
+    UniformBuffer<ShadowBlock> shadowBuffer;
+    // Number of tiles rendered in the last frame, static and moving casters counted apart
+    GLuint renderedTileCount;
+
+    // Creates a depth atlas with hardware depth comparison, and a framebuffer rendering into it.
+    void createAtlas(GLuint& texture, GLuint& targetFramebuffer) {
+        glGenTextures(1, &texture);
+        GLState::bindTexture(SHADOW_ATLAS_UNIT, GL_TEXTURE_2D, texture);
+        GLState::setActiveTexture(SHADOW_ATLAS_UNIT);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, this->atlasWidth, this->atlasHeight);
+        // Linear filtering compares 2x2 texels (percentage-closer filtering)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glGenFramebuffers(1, &targetFramebuffer);
+        GLState::bindFramebuffer(targetFramebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR: Shadow atlas framebuffer is incomplete." << std::endl;
+
+        // Nothing casts a shadow until the first render
+        GLState::setDepthMask(true);
+        glClearDepth(1.0);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        GLState::bindFramebuffer(0);
+    }
+
+    // Adds a view rendered into the tile at the given corner of the atlas.
+    void addView(int x, int y, int size) {
+        ShadowView view;
+        view.camera = CameraBlock();
+        view.x = x;
+        view.y = y;
+        view.size = size;
+        view.isStaticValid = false;
+        view.hasDynamicCasters = false;
+        this->views.push_back(view);
+    }
+
+    // Sets the camera of a view; its static tile is rendered again if the camera changed.
+    void setCamera(ShadowView& view, const glm::mat4& projection, const glm::mat4& viewMatrix, const glm::vec3& position, float zFar) {
+        if (view.camera.projection != projection || view.camera.view != viewMatrix)
+            view.isStaticValid = false;
+
+        view.camera.projection = projection;
+        view.camera.view = viewMatrix;
+        view.camera.cameraPos = position;
+        view.camera.zFar = zFar;
+    }
+
+    // Returns the matrix from world space to atlas texture coordinates and depth of a view.
+    glm::mat4 computeAtlasMatrix(const ShadowView& view) {
+        // Clip space [-1, 1] to the tile's texture coordinates, depth to [0, 1]
+        glm::vec3 scale = glm::vec3(view.size * 0.5f / this->atlasWidth, view.size * 0.5f / this->atlasHeight, 0.5f);
+        glm::vec3 offset = glm::vec3((view.x + view.size * 0.5f) / this->atlasWidth, (view.y + view.size * 0.5f) / this->atlasHeight, 0.5f);
+        glm::mat4 tile = glm::scale(glm::translate(glm::mat4(1.0f), offset), scale);
+        return tile * view.camera.projection * view.camera.view;
+    }
+
+    // Returns the bounds of a view's tile in texture coordinates, inset by half a texel so that filtering stays inside.
+    glm::vec4 computeRect(const ShadowView& view) {
+        return glm::vec4(
+            (view.x + 0.5f) / this->atlasWidth,
+            (view.y + 0.5f) / this->atlasHeight,
+            (view.x + view.size - 0.5f) / this->atlasWidth,
+            (view.y + view.size - 0.5f) / this->atlasHeight
+        );
+    }
+
+    // Finds the casters that moved since the last frame. Returns true if the set of static casters changed.
+    bool updateCasters() {
+        bool hasStaticSetChanged = false;
+        for (Caster& caster : this->casters) {
+            glm::mat4 transform = caster.model->computeTransMatrix();
+            if (transform != caster.transform) {
+                caster.transform = transform;
+                caster.stillFrames = 0;
+            }
+            else if (caster.stillFrames < SETTLE_FRAMES)
+                caster.stillFrames++;
+
+            bool isDynamic = caster.stillFrames < SETTLE_FRAMES;
+            if (isDynamic != caster.isDynamic) {
+                caster.isDynamic = isDynamic;
+                hasStaticSetChanged = true;
+            }
+        }
+        return hasStaticSetChanged;
+    }
+
+    // Places the cameras of the views around the lights of this frame.
+    void updateViews() {
+        // Directional light: an orthographic view looking along the light, around the snapped focus point
+        ShadowView& directionalView = this->views[0];
+        glm::vec3 direction = glm::normalize(this->directionalLight->getPosition());
+        glm::vec3 center = glm::floor(this->focus / DIRECTIONAL_SNAP + 0.5f) * DIRECTIONAL_SNAP;
+        glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 eye = center + direction * (DIRECTIONAL_DEPTH * 0.5f);
+        float halfExtent = DIRECTIONAL_EXTENT * 0.5f;
+        this->setCamera(directionalView,
+            glm::ortho(-halfExtent, halfExtent, -halfExtent, halfExtent, 0.0f, DIRECTIONAL_DEPTH),
+            glm::lookAt(eye, center, up), eye, DIRECTIONAL_DEPTH);
+
+        // Point light: a 90 degree perspective view per cube face, reaching as far as the light does
+        const glm::vec3 faceDirections[6] = {
+            glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+            glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)
+        };
+        const glm::vec3 faceUps[6] = {
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+            glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+            glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)
+        };
+        glm::vec3 position = this->pointLight->getPosition();
+        float zFar = glm::clamp(this->pointLight->computeRadius(), POINT_NEAR * 2.0f, POINT_MAX_FAR);
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, POINT_NEAR, zFar);
+        for (int face = 0; face < 6; face++) {
+            this->setCamera(this->views[1 + face], projection,
+                glm::lookAt(position, position + faceDirections[face], faceUps[face]), position, zFar);
+        }
+    }
+
+    // Draws the static or the moving casters into a view's tile of the bound framebuffer. Returns false if they could not be drawn this frame.
+    bool drawCasters(const ShadowView& view, bool isDynamic) {
+        // The culling and depth shaders read the light's camera
+        StreamBuffer::Allocation camera = StreamBuffer::shared().allocate(sizeof(CameraBlock));
+        if (camera.data == NULL)
+            return false;
+        *(CameraBlock*)camera.data = view.camera;
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, camera.buffer, camera.offset, camera.size);
+
+        this->batch.begin(view.camera);
+        for (Caster& caster : this->casters) {
+            if (caster.isDynamic == isDynamic)
+                caster.model->submit(this->batch);
+        }
+
+        GLState::setViewport(view.x, view.y, view.size, view.size);
+        this->batch.drawDepth();
+        this->renderedTileCount++;
+        return true;
+    }
+
+    // Draws the static casters into the invalid static tiles, and the moving casters on top of copies of them.
+    void renderTiles() {
+        if (this->updateCasters())
+            this->invalidate();
+
+        bool hasDynamicCasters = false;
+        for (const Caster& caster : this->casters)
+            hasDynamicCasters = hasDynamicCasters || caster.isDynamic;
+
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(POLYGON_OFFSET_FACTOR, POLYGON_OFFSET_UNITS);
+        glEnable(GL_SCISSOR_TEST);
+
+        for (ShadowView& view : this->views) {
+            // Static casters, only when the light or the static set changed
+            bool hasStaticTileChanged = !view.isStaticValid;
+            if (hasStaticTileChanged) {
+                GLState::bindFramebuffer(this->staticFramebuffer);
+                glScissor(view.x, view.y, view.size, view.size);
+                GLState::setDepthMask(true);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                // A tile that could not be drawn is tried again next frame
+                view.isStaticValid = this->drawCasters(view, false);
+            }
+
+            // Moving casters on top of a copy of the static tile; the copy also clears the ones of the last frame
+            if (!hasStaticTileChanged && !hasDynamicCasters && !view.hasDynamicCasters)
+                continue;
+
+            glCopyImageSubData(this->staticAtlas, GL_TEXTURE_2D, 0, view.x, view.y, 0,
+                this->atlas, GL_TEXTURE_2D, 0, view.x, view.y, 0, view.size, view.size, 1);
+            if (hasDynamicCasters) {
+                GLState::bindFramebuffer(this->framebuffer);
+                this->drawCasters(view, true);
+            }
+            view.hasDynamicCasters = hasDynamicCasters;
+        }
+
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+
+        // Bind the camera of the frame again for the passes after this one
+        if (this->renderedTileCount > 0)
+            this->cameraBuffer->bind();
+    }
+
+public:
+    // Instantiates a Shadow Maps object for the lights; the casters are drawn with the depth pre-pass shader
+    // (see depth.vert) and their instanced groups culled with the instance culler (may be NULL).
+    ShadowMaps(DirectionalLight* directionalLight, PointLight* pointLight, UniformBuffer<CameraBlock>* cameraBuffer,
+        Shader* depthShader, InstanceCuller* instanceCuller) : shadowBuffer(SHADOW_BLOCK_BINDING) {
+        this->directionalLight = directionalLight;
+        this->pointLight = pointLight;
+        this->cameraBuffer = cameraBuffer;
+        this->depthShader = depthShader;
+        this->focus = glm::vec3(0.0f);
+        this->renderedTileCount = 0;
+
+        this->batch.setDepthPrePass(depthShader);
+        this->batch.setInstanceCuller(instanceCuller);
+
+        // Directional light's tile on the left, the point light's faces in two rows of three on the right
+        this->atlasWidth = DIRECTIONAL_TILE_SIZE + POINT_TILE_SIZE * 3;
+        this->atlasHeight = std::max(DIRECTIONAL_TILE_SIZE, POINT_TILE_SIZE * 2);
+        this->addView(0, 0, DIRECTIONAL_TILE_SIZE);
+        for (int face = 0; face < 6; face++)
+            this->addView(DIRECTIONAL_TILE_SIZE + (face % 3) * POINT_TILE_SIZE, (face / 3) * POINT_TILE_SIZE, POINT_TILE_SIZE);
+
+        this->createAtlas(this->atlas, this->framebuffer);
+        this->createAtlas(this->staticAtlas, this->staticFramebuffer);
+
+        this->shadowBlock = ShadowBlock();
+        this->pointLight->setCastsShadows(true);
+    }
+
+    // Adds a model casting shadows; it must outlive the shadow maps.
+    void addCaster(Model* model) {
+        Caster caster;
+        caster.model = model;
+        caster.transform = model->computeTransMatrix();
+        caster.stillFrames = SETTLE_FRAMES;
+        caster.isDynamic = false;
+        this->casters.push_back(caster);
+    }
+
+    // Sets the point the directional light's tile is centered on (e.g. the player's position).
+    void setFocus(const glm::vec3& focus) {
+        this->focus = focus;
+    }
+
+    // Renders every static tile again, e.g. after the casters' meshes were reloaded.
+    void invalidate() {
+        for (ShadowView& view : this->views)
+            view.isStaticValid = false;
+    }
+
+    // Renders the tiles whose light or casters moved, and binds the atlas for the model shader.
+    void render() {
+        this->renderedTileCount = 0;
+        this->updateViews();
+
+        // The casters would be missing from the cached tiles until the shader is ready
+        if (this->depthShader->isReady())
+            this->renderTiles();
+
+        // Views of the tiles for the model shader
+        this->shadowBlock.directionalMatrix = this->computeAtlasMatrix(this->views[0]);
+        this->shadowBlock.directionalRect = this->computeRect(this->views[0]);
+        this->shadowBlock.directionalNormalOffset = DIRECTIONAL_EXTENT / DIRECTIONAL_TILE_SIZE * NORMAL_OFFSET_TEXELS;
+        for (int face = 0; face < 6; face++) {
+            this->shadowBlock.pointMatrices[face] = this->computeAtlasMatrix(this->views[1 + face]);
+            this->shadowBlock.pointRects[face] = this->computeRect(this->views[1 + face]);
+        }
+        // A 90 degree face spans twice the distance to the light
+        this->shadowBlock.pointNormalOffset = 2.0f / POINT_TILE_SIZE * NORMAL_OFFSET_TEXELS;
+        this->shadowBuffer.update(this->shadowBlock);
+
+        GLState::bindTexture(SHADOW_ATLAS_UNIT, GL_TEXTURE_2D, this->atlas);
+    }
+
+    // Returns the number of tiles rendered in the last frame, static and moving casters counted apart.
+    GLuint getRenderedTileCount() {
+        return this->renderedTileCount;
+    }
+};
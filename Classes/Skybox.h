@@ -1,5 +1,9 @@
 #pragma once
 
+/******** SKYBOX TEXTURE UNIT ********/
+// Must match the binding layout qualifiers of skybox in skybox.frag and of fogSkybox in main.frag
+const GLenum SKYBOX_UNIT = GL_TEXTURE13;
+
 /*
 	Skybox class implementation. Holds every skybox-related functionality.
 */
@@ -14,6 +18,19 @@ private:
     // Flag for showing the skybox color or not
     bool showColor;
 
+    // Uniform handles of the skybox attributes within a shader
+    struct SkyboxUniforms {
+        Uniform<bool> showColor;
+        Uniform<glm::vec3> skyboxColor;
+
+        SkyboxUniforms(const Shader& shader) {
+            this->showColor = shader.getUniform<bool>("showColor");
+            this->skyboxColor = shader.getUniform<glm::vec3>("skyboxColor");
+        }
+    };
+    // Cached uniform handles per shader this skybox is drawn with
+    UniformCache<SkyboxUniforms> uniforms;
+
     // Initializes the cubemap of this skybox.
     void initCubemap() {
         // Size of cube (for vertices)
@@ -140,7 +157,7 @@ private:
         }
 
         // Instantiate Texture object of this skybox
-        this->texture = Texture(texture, GL_TEXTURE0);
+        this->texture = Texture(texture, SKYBOX_UNIT, GL_TEXTURE_CUBE_MAP);
 
         // Reset this to true
         stbi_set_flip_vertically_on_load(true);
@@ -163,34 +180,39 @@ public:
 	}
 
     // Draw the skybox using the shader.
-    void draw(Shader shader) {
-        glEnable(GL_BLEND);
+    void draw(Shader& shader) {
+        GLState::setColorMask(true);
+        GLState::setBlend(true);
 
         // Default blending function
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        glDepthMask(GL_FALSE);
-        glDepthFunc(GL_LEQUAL);
+        GLState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // Draw behind everything without writing depth
+        GLState::setDepthTest(true);
+        GLState::setDepthMask(false);
+        GLState::setDepthFunc(GL_LEQUAL);
 
         // Bind the skybox VAO to the shader
-        glBindVertexArray(this->VAO);
+        GLState::bindVertexArray(this->VAO);
 
         // Tell the shader to render skybox color or not
-        shader.setBool("showColor", this->showColor);
+        const SkyboxUniforms& uniforms = this->uniforms.get(shader);
+        uniforms.showColor.set(this->showColor);
 
         // If the skybox color must be shown
         if (this->showColor)
             // Link color
-            shader.setVec3("skyboxColor", this->color);
+            uniforms.skyboxColor.set(this->color);
 
         // Bind skybox texture
         this->texture.bind();
 
-        // Draw skybox
+        // Draw skybox; whatever is drawn next sets the depth state it needs
         glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    }
 
-        // Reset deppth mask and depth function
-        glDepthMask(GL_TRUE);
-        glDepthFunc(GL_LESS);
+    // Binds the cubemap of this skybox for the models' shader; distant models fade into it through the fog.
+    void bindCubemap() {
+        this->texture.bind();
     }
 
     // Toggles texture color usage; to use default texture color or green only.
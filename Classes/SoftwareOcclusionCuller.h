@@ -0,0 +1,406 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Frustum.h"
+
+/*
+    Software Occlusion Culler class implementation. Rasterizes a few occluder meshes into a small depth
+    buffer on the CPU, builds a depth pyramid (hierarchical Z) from it, and tests bounding boxes against
+    the pyramid. Results are available within the same frame and nothing is read back from the GPU.
+
+    The depth buffer is split into horizontal bands, each rasterized by its own worker thread. Pixels are
+    processed four at a time where SSE is available.
+
+    The test errs on the side of drawing: pixels store the farthest depth of a triangle within them,
+    triangles crossing the near plane are not drawn, and boxes are tested one texel beyond their bounds,
+    which covers occluder edges growing by up to half a texel through pixel-center sampling.
+ */
+class SoftwareOcclusionCuller {
+private:
+    // A mesh drawn into the depth buffer this frame
+    struct Occluder {
+        const std::vector<glm::vec3>* vertices;
+        glm::mat4 model;
+    };
+
+    // A screen-space triangle prepared for rasterization (pixel units)
+    struct Triangle {
+        // Edge functions A * x + B * y + C; non-negative at pixel centers inside the edge
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // Depth plane (farthest depth within the pixel) and the farthest depth of the triangle
+        float depthA;
+        float depthB;
+        float depthC;
+        float maxDepth;
+        // Pixel bounds
+        int minX;
+        int maxX;
+        int minY;
+        int maxY;
+    };
+
+    // Size of the depth buffer; the width must be a multiple of 4
+    const int DEPTH_WIDTH = 256;
+    const int DEPTH_HEIGHT = 128;
+    // Clip-space w below which a vertex counts as being on or behind the camera
+    const float MIN_CLIP_W = 1e-5f;
+
+    // View-projection matrix of the camera of this frame
+    glm::mat4 viewProjection;
+    // Occluders submitted this frame
+    std::vector<Occluder> occluders;
+    // Triangles of the occluders, prepared for rasterization
+    std::vector<Triangle> triangles;
+    // Depth pyramid; level 0 is the depth buffer, each further level holds the farthest depth of 2x2 texels
+    std::vector<std::vector<float>> levels;
+    // Flag to determine if the pyramid holds the occluders of this frame
+    bool isRasterized;
+
+    // Worker threads; worker i rasterizes band i + 1, band 0 is rasterized by the calling thread
+    std::vector<std::thread> workers;
+    // Guards the fields below between the workers and the calling thread
+    std::mutex workMutex;
+    // Signals the workers that a frame is ready to be rasterized
+    std::condition_variable workReady;
+    // Signals the calling thread that every band was rasterized
+    std::condition_variable workDone;
+    // Incremented for every frame to be rasterized
+    unsigned long long generation;
+    // Number of bands still being rasterized by the workers
+    int pendingBands;
+    // Flag that keeps the workers running
+    bool running;
+
+    // Number of bands the depth buffer is split into.
+    int getBandCount() const {
+        return (int)this->workers.size() + 1;
+    }
+
+    // Prepares a triangle from its clip-space vertices. Returns false if it covers no pixel or is not fully in front of the camera.
+    bool setupTriangle(const glm::vec4 clip[3], Triangle& triangle) const {
+        float x[3], y[3], z[3];
+        for (int i = 0; i < 3; i++) {
+            // Drawing only part of a triangle crossing the near plane would need clipping; skipping it is conservative
+            if (clip[i].w < MIN_CLIP_W || clip[i].z < -clip[i].w)
+                return false;
+
+            float invW = 1.0f / clip[i].w;
+            x[i] = (clip[i].x * invW * 0.5f + 0.5f) * DEPTH_WIDTH;
+            y[i] = (clip[i].y * invW * 0.5f + 0.5f) * DEPTH_HEIGHT;
+            z[i] = clip[i].z * invW * 0.5f + 0.5f;
+        }
+
+        // Twice the signed area; both windings are drawn
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::fabs(area) < 1e-6f)
+            return false;
+
+        triangle.minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+        triangle.maxX = std::min(DEPTH_WIDTH - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+        triangle.minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+        triangle.maxY = std::min(DEPTH_HEIGHT - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return false;
+
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int i = 0; i < 3; i++) {
+            int j = (i + 1) % 3;
+            float a = -(y[j] - y[i]) * sign;
+            float b = (x[j] - x[i]) * sign;
+            triangle.edgeA[i] = a;
+            triangle.edgeB[i] = b;
+            triangle.edgeC[i] = -(a * x[i] + b * y[i]);
+        }
+
+        // Depth is linear in screen space after the perspective divide
+        float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        triangle.depthA = dzdx;
+        triangle.depthB = dzdy;
+        // Evaluate the depth at the pixel's farthest corner instead of its center
+        triangle.depthC = z[0] - dzdx * x[0] - dzdy * y[0] + 0.5f * (std::fabs(dzdx) + std::fabs(dzdy));
+        triangle.maxDepth = std::max(z[0], std::max(z[1], z[2]));
+        return true;
+    }
+
+    // Rasterizes every triangle into the rows of a band.
+    void rasterizeBand(int band) {
+        int bandHeight = DEPTH_HEIGHT / this->getBandCount();
+        int firstRow = band * bandHeight;
+        int lastRow = band == this->getBandCount() - 1 ? DEPTH_HEIGHT - 1 : firstRow + bandHeight - 1;
+        std::vector<float>& depth = this->levels[0];
+
+        for (const Triangle& triangle : this->triangles) {
+            int minY = std::max(triangle.minY, firstRow);
+            int maxY = std::min(triangle.maxY, lastRow);
+
+            for (int y = minY; y <= maxY; y++) {
+                float* row = &depth[y * DEPTH_WIDTH];
+                float centerY = y + 0.5f;
+                int x = triangle.minX;
+
+#ifdef HAS_SSE
+                // Start at a multiple of 4; the width is a multiple of 4, so a group never leaves the row
+                x &= ~3;
+                __m128 edgeRow[3];
+                __m128 edgeA[3];
+                for (int i = 0; i < 3; i++) {
+                    edgeRow[i] = _mm_set1_ps(triangle.edgeB[i] * centerY + triangle.edgeC[i]);
+                    edgeA[i] = _mm_set1_ps(triangle.edgeA[i]);
+                }
+                __m128 depthRow = _mm_set1_ps(triangle.depthB * centerY + triangle.depthC);
+                __m128 depthA = _mm_set1_ps(triangle.depthA);
+                __m128 maxDepth = _mm_set1_ps(triangle.maxDepth);
+                __m128 zero = _mm_setzero_ps();
+
+                for (; x <= triangle.maxX; x += 4) {
+                    __m128 centerX = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+
+                    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], centerX), edgeRow[0]), zero);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], centerX), edgeRow[1]), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], centerX), edgeRow[2]), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    // Keep the nearest depth of the covered pixels
+                    __m128 pixelDepth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthA, centerX), depthRow), maxDepth);
+                    __m128 oldDepth = _mm_loadu_ps(row + x);
+                    __m128 newDepth = _mm_min_ps(oldDepth, pixelDepth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, newDepth), _mm_andnot_ps(inside, oldDepth)));
+                }
+#else
+                for (; x <= triangle.maxX; x++) {
+                    float centerX = x + 0.5f;
+
+                    bool isInside = true;
+                    for (int i = 0; i < 3; i++)
+                        isInside = isInside && triangle.edgeA[i] * centerX + triangle.edgeB[i] * centerY + triangle.edgeC[i] >= 0.0f;
+                    if (!isInside)
+                        continue;
+
+                    // Keep the nearest depth of the covered pixels
+                    float pixelDepth = std::min(triangle.depthA * centerX + triangle.depthB * centerY + triangle.depthC, triangle.maxDepth);
+                    row[x] = std::min(row[x], pixelDepth);
+                }
+#endif
+            }
+        }
+    }
+
+    // Runs on a worker thread and rasterizes its band of every frame.
+    void workerLoop(int band) {
+        unsigned long long seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(this->workMutex);
+                this->workReady.wait(lock, [this, seenGeneration]() { return !this->running || this->generation != seenGeneration; });
+                if (!this->running)
+                    return;
+                seenGeneration = this->generation;
+            }
+
+            this->rasterizeBand(band);
+
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            if (--this->pendingBands == 0)
+                this->workDone.notify_one();
+        }
+    }
+
+    // Fills every level above the depth buffer with the farthest depth of the 2x2 texels below it.
+    void buildPyramid() {
+        for (size_t level = 1; level < this->levels.size(); level++) {
+            const std::vector<float>& source = this->levels[level - 1];
+            std::vector<float>& target = this->levels[level];
+            int sourceWidth = DEPTH_WIDTH >> (level - 1);
+            int width = DEPTH_WIDTH >> level;
+            int height = DEPTH_HEIGHT >> level;
+
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    const float* texels = &source[(y * 2) * sourceWidth + x * 2];
+                    target[y * width + x] = std::max(
+                        std::max(texels[0], texels[1]),
+                        std::max(texels[sourceWidth], texels[sourceWidth + 1])
+                    );
+                }
+            }
+        }
+    }
+
+public:
+    // Instantiates a Software Occlusion Culler object rasterizing with the given number of worker threads
+    // besides the calling thread. By default, one per spare hardware thread (at most 3).
+    SoftwareOcclusionCuller(int workerCount = -1) {
+        this->viewProjection = glm::mat4(1.0f);
+        this->isRasterized = false;
+        this->generation = 0;
+        this->pendingBands = 0;
+        this->running = true;
+
+        // Every level down to a single row
+        for (int level = 0; (DEPTH_HEIGHT >> level) > 0; level++)
+            this->levels.push_back(std::vector<float>((DEPTH_WIDTH >> level) * (DEPTH_HEIGHT >> level), 1.0f));
+
+        if (workerCount < 0)
+            workerCount = std::min(3, (int)std::thread::hardware_concurrency() - 1);
+        for (int i = 0; i < workerCount; i++)
+            this->workers.push_back(std::thread(&SoftwareOcclusionCuller::workerLoop, this, i + 1));
+    }
+
+    // Stops the worker threads when the culler goes out of scope.
+    ~SoftwareOcclusionCuller() {
+        {
+            std::lock_guard<std::mutex> lock(this->workMutex);
+            this->running = false;
+        }
+        this->workReady.notify_all();
+        for (std::thread& worker : this->workers)
+            worker.join();
+    }
+
+    // Clears the occluders of the previous frame. Occluders and objects are projected with the given camera.
+    void begin(const CameraBlock& camera) {
+        this->viewProjection = camera.projection * camera.view;
+        this->occluders.clear();
+        this->isRasterized = false;
+    }
+
+    // Submits a mesh (triangle list of model-space positions) to occlude objects behind it this frame.
+    // The vertices must stay alive until the frame was rasterized.
+    void addOccluder(const std::vector<glm::vec3>& vertices, const glm::mat4& model) {
+        Occluder occluder;
+        occluder.vertices = &vertices;
+        occluder.model = model;
+        this->occluders.push_back(occluder);
+    }
+
+    // Rasterizes the occluders of this frame and builds the depth pyramid.
+    void rasterize() {
+        // Project the triangles once; every band reads them
+        this->triangles.clear();
+        for (const Occluder& occluder : this->occluders) {
+            glm::mat4 mvp = this->viewProjection * occluder.model;
+            const std::vector<glm::vec3>& vertices = *occluder.vertices;
+
+            for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+                glm::vec4 clip[3] = {
+                    mvp * glm::vec4(vertices[i], 1.0f),
+                    mvp * glm::vec4(vertices[i + 1], 1.0f),
+                    mvp * glm::vec4(vertices[i + 2], 1.0f)
+                };
+
+                Triangle triangle;
+                if (this->setupTriangle(clip, triangle))
+                    this->triangles.push_back(triangle);
+            }
+        }
+
+        std::fill(this->levels[0].begin(), this->levels[0].end(), 1.0f);
+
+        if (!this->triangles.empty()) {
+            // Hand the other bands to the workers and rasterize the first one here
+            {
+                std::lock_guard<std::mutex> lock(this->workMutex);
+                this->generation++;
+                this->pendingBands = (int)this->workers.size();
+            }
+            this->workReady.notify_all();
+
+            this->rasterizeBand(0);
+
+            std::unique_lock<std::mutex> lock(this->workMutex);
+            this->workDone.wait(lock, [this]() { return this->pendingBands == 0; });
+        }
+
+        this->buildPyramid();
+        this->isRasterized = true;
+    }
+
+    // Returns true if any part of the world-space bounding box may be visible past the occluders.
+    bool isVisible(const AABB& bounds) const {
+        if (!this->isRasterized || this->triangles.empty())
+            return true;
+
+        // Project the corners of the box; its nearest depth is compared against the pyramid
+        glm::vec2 minPixel = glm::vec2(FLT_MAX);
+        glm::vec2 maxPixel = glm::vec2(-FLT_MAX);
+        float minDepth = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 position = glm::vec3(
+                corner & 1 ? bounds.max.x : bounds.min.x,
+                corner & 2 ? bounds.max.y : bounds.min.y,
+                corner & 4 ? bounds.max.z : bounds.min.z
+            );
+            glm::vec4 clip = this->viewProjection * glm::vec4(position, 1.0f);
+
+            // The box reaches the camera
+            if (clip.w < MIN_CLIP_W || clip.z < -clip.w)
+                return true;
+
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 pixel = (glm::vec2(ndc) * 0.5f + 0.5f) * glm::vec2((float)DEPTH_WIDTH, (float)DEPTH_HEIGHT);
+            minPixel = glm::min(minPixel, pixel);
+            maxPixel = glm::max(maxPixel, pixel);
+            minDepth = std::min(minDepth, ndc.z * 0.5f + 0.5f);
+        }
+
+        // Off screen; left to frustum culling
+        if (maxPixel.x < 0.0f || maxPixel.y < 0.0f || minPixel.x >= DEPTH_WIDTH || minPixel.y >= DEPTH_HEIGHT)
+            return true;
+
+        // One texel beyond the projected bounds, clamped to the screen
+        int minX = std::max(0, (int)std::floor(minPixel.x) - 1);
+        int maxX = std::min(DEPTH_WIDTH - 1, (int)std::floor(maxPixel.x) + 1);
+        int minY = std::max(0, (int)std::floor(minPixel.y) - 1);
+        int maxY = std::min(DEPTH_HEIGHT - 1, (int)std::floor(maxPixel.y) + 1);
+
+        // Pick the level where the box covers at most 2x2 texels
+        int level = 0;
+        while (level + 1 < (int)this->levels.size() && ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1))
+            level++;
+
+        const std::vector<float>& depth = this->levels[level];
+        int width = DEPTH_WIDTH >> level;
+        for (int y = minY >> level; y <= maxY >> level; y++) {
+            for (int x = minX >> level; x <= maxX >> level; x++) {
+                if (minDepth <= depth[y * width + x])
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true if the depth pyramid holds occluders of this frame.
+    bool hasOccluders() const {
+        return this->isRasterized && !this->triangles.empty();
+    }
+
+    // Returns the number of levels of the depth pyramid.
+    int getLevelCount() const {
+        return (int)this->levels.size();
+    }
+
+    // Returns a level of the depth pyramid (rows from the bottom of the screen up) and its size in texels.
+    const std::vector<float>& getLevel(int level, int& width, int& height) const {
+        width = DEPTH_WIDTH >> level;
+        height = DEPTH_HEIGHT >> level;
+        return this->levels[level];
+    }
+
+    // Returns the number of occluder triangles rasterized this frame.
+    GLuint getTriangleCount() {
+        return (GLuint)this->triangles.size();
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GLState.h"
+#include "ObjectBatch.h"
+#include "Shader.h"
+#include "UniformBuffer.h"
+
+/*
+    Sonar View class implementation. Low-cost render path of the player's first POV, where every creature
+    shows as a flat color. Models are drawn from the position-only vertex stream with a minimal shader (see
+    sonar.vert), without textures, normal mapping, lighting, or a depth pre-pass, at a reduced resolution.
+    A post-pass then stretches the result over the window and outlines the depth discontinuities, which
+    gives the creatures the contours of a sonar image (see contour.frag). The skybox is not drawn; pixels
+    without a model show the background color instead.
+ */
+class SonarView {
+private:
+    // Uniform handles of the contour shader
+    struct ContourUniforms {
+        Uniform<int> sceneColor;
+        Uniform<int> sceneDepth;
+        Uniform<glm::vec2> uvScale;
+        Uniform<glm::vec2> texelSize;
+        Uniform<glm::vec2> outputSize;
+        Uniform<glm::vec2> depthTerms;
+        Uniform<float> contourThreshold;
+        Uniform<glm::vec3> contourColor;
+        Uniform<glm::vec3> backgroundColor;
+
+        ContourUniforms(const Shader& shader) {
+            this->sceneColor = shader.getUniform<int>("sceneColor");
+            this->sceneDepth = shader.getUniform<int>("sceneDepth");
+            this->uvScale = shader.getUniform<glm::vec2>("uvScale");
+            this->texelSize = shader.getUniform<glm::vec2>("texelSize");
+            this->outputSize = shader.getUniform<glm::vec2>("outputSize");
+            this->depthTerms = shader.getUniform<glm::vec2>("depthTerms");
+            this->contourThreshold = shader.getUniform<float>("contourThreshold");
+            this->contourColor = shader.getUniform<glm::vec3>("contourColor");
+            this->backgroundColor = shader.getUniform<glm::vec3>("backgroundColor");
+        }
+    };
+    // Cached uniform handles of the contour shader
+    UniformCache<ContourUniforms> uniforms;
+
+    // Fraction of the window's width and height the sonar is drawn at, at most
+    const float RESOLUTION_SCALE = 0.5f;
+    // Relative change of distance between neighboring texels that counts as a contour
+    const float CONTOUR_THRESHOLD = 0.1f;
+    // Texture units the scene is sampled from
+    const GLenum COLOR_UNIT = GL_TEXTURE0;
+    const GLenum DEPTH_UNIT = GL_TEXTURE1;
+
+    // Shader drawing the models in their flat color
+    Shader* flatShader;
+    // Shader stretching the scene and drawing the contours
+    Shader* contourShader;
+    // Empty vertex array; the fullscreen triangle is generated from the vertex IDs
+    GLuint VAO;
+    // Colors of the contours and of the background
+    glm::vec3 contourColor;
+    glm::vec3 backgroundColor;
+
+public:
+    // Instantiates a Sonar View object drawing the models with the flat shader (see sonar.vert) and the
+    // contours with the contour shader (see fullscreen.vert and contour.frag).
+    SonarView(Shader* flatShader, Shader* contourShader, glm::vec3 backgroundColor, glm::vec3 contourColor = glm::vec3(0.6f, 1.0f, 0.6f)) {
+        this->flatShader = flatShader;
+        this->contourShader = contourShader;
+        this->backgroundColor = backgroundColor;
+        this->contourColor = contourColor;
+
+        glGenVertexArrays(1, &this->VAO);
+    }
+
+    // Returns true if both shaders finished building; until then the textured path is used. Never blocks on the driver.
+    bool isReady() {
+        return this->flatShader->isReady() && this->contourShader->isReady();
+    }
+
+    // Draws the objects of the batch in their flat color into the bound framebuffer.
+    void draw(ObjectBatch& batch) {
+        batch.drawFlat(this->flatShader);
+    }
+
+    // Draws the scene (the drawn part of the given textures) stretched over the bound framebuffer, with contours
+    // where the depth of the camera's view changes sharply.
+    void drawContours(GLuint colorTexture, GLuint depthTexture, GLsizei textureWidth, GLsizei textureHeight,
+        GLsizei drawnWidth, GLsizei drawnHeight, GLsizei outputWidth, GLsizei outputHeight, const CameraBlock& camera) {
+        GLState::setDepthTest(false);
+        GLState::setBlend(false);
+        GLState::setColorMask(true);
+
+        this->contourShader->use();
+        const ContourUniforms& uniforms = this->uniforms.get(*this->contourShader);
+        GLState::bindTexture(COLOR_UNIT, GL_TEXTURE_2D, colorTexture);
+        GLState::bindTexture(DEPTH_UNIT, GL_TEXTURE_2D, depthTexture);
+        uniforms.sceneColor.set(COLOR_UNIT - GL_TEXTURE0);
+        uniforms.sceneDepth.set(DEPTH_UNIT - GL_TEXTURE0);
+        uniforms.uvScale.set(glm::vec2((float)drawnWidth / textureWidth, (float)drawnHeight / textureHeight));
+        uniforms.texelSize.set(glm::vec2(1.0f / textureWidth, 1.0f / textureHeight));
+        uniforms.outputSize.set(glm::vec2((float)outputWidth, (float)outputHeight));
+        uniforms.depthTerms.set(glm::vec2(camera.projection[2][2], camera.projection[3][2]));
+        uniforms.contourThreshold.set(CONTOUR_THRESHOLD);
+        uniforms.contourColor.set(this->contourColor);
+        uniforms.backgroundColor.set(this->backgroundColor);
+
+        GLState::bindVertexArray(this->VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // Returns the largest fraction of the window's width and height the sonar is drawn at.
+    float getResolutionScale() {
+        return RESOLUTION_SCALE;
+    }
+};
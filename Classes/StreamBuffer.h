@@ -0,0 +1,164 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+/*
+    Stream Buffer class implementation. Ring allocator for data that is written once per frame by the CPU
+    and read by the GPU in the same frame (object attributes, indirect commands, text vertices).
+
+    The buffer is allocated once with immutable storage and stays mapped (persistent and coherent), so
+    writes go straight into memory the GPU reads, without reallocating driver storage or synchronizing
+    implicitly. The buffer is split into one region per frame in flight; a fence placed at the end of a
+    frame guards its region, which is only reused once the GPU finished that frame.
+
+    Allocations are only valid until the end of the frame. A frame writing more than a region holds moves
+    the ring to a larger buffer; the old buffer is released at the end of the frame.
+ */
+class StreamBuffer {
+public:
+    // Part of the stream buffer written this frame
+    struct Allocation {
+        // Buffer and byte offset to bind the data with
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+        // Mapped memory to write the data to
+        void* data;
+    };
+
+private:
+    // Number of frames the GPU may still be reading while the CPU writes the next one
+    static const int FRAME_COUNT = 3;
+    // Size of a region when the ring is created (in bytes)
+    const GLsizeiptr INITIAL_REGION_SIZE = 1 << 20;
+
+    // The buffer holding every region
+    GLuint buffer;
+    // Mapped memory of the buffer
+    char* mappedData;
+    // Size of each region (in bytes)
+    GLsizeiptr regionSize;
+    // Region written this frame
+    int region;
+    // Bytes of the region allocated this frame
+    GLsizeiptr head;
+    // Offset every allocation is aligned to; suits uniform and shader storage buffer bindings
+    GLsizeiptr alignment;
+    // Fence of the last frame written to each region (0 if the region is free)
+    GLsync fences[FRAME_COUNT];
+    // Buffers replaced by a larger one this frame; released at the end of the frame
+    std::vector<GLuint> retiredBuffers;
+
+    // Instantiates a Stream Buffer object; the ring is shared, see shared().
+    StreamBuffer() {
+        this->buffer = 0;
+        this->mappedData = NULL;
+        this->regionSize = 0;
+        this->region = 0;
+        this->head = 0;
+        for (int i = 0; i < FRAME_COUNT; i++)
+            this->fences[i] = 0;
+
+        GLint uniformAlignment = 1;
+        GLint storageAlignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+        this->alignment = std::max<GLsizeiptr>(16, std::max(uniformAlignment, storageAlignment));
+
+        this->createBuffer(INITIAL_REGION_SIZE);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Creates a mapped buffer with regions of the given size, replacing the current one.
+    void createBuffer(GLsizeiptr regionSize) {
+        // Regions of the old buffer are no longer written to, so their fences are not needed
+        if (this->buffer != 0) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            this->retiredBuffers.push_back(this->buffer);
+        }
+        for (int i = 0; i < FRAME_COUNT; i++) {
+            if (this->fences[i] != 0)
+                glDeleteSync(this->fences[i]);
+            this->fences[i] = 0;
+        }
+
+        this->regionSize = regionSize;
+        this->region = 0;
+        this->head = 0;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &this->buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, this->regionSize * FRAME_COUNT, NULL, flags);
+        this->mappedData = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, this->regionSize * FRAME_COUNT, flags);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        if (this->mappedData == NULL)
+            std::cout << "ERROR: Unable to map the stream buffer!" << std::endl;
+    }
+
+public:
+    // Returns the ring shared by every user of the (single) OpenGL context.
+    static StreamBuffer& shared() {
+        static StreamBuffer streamBuffer;
+        return streamBuffer;
+    }
+
+    // Allocates the given number of bytes for this frame. Returns an allocation without data if the buffer could not be mapped.
+    Allocation allocate(GLsizeiptr size) {
+        GLsizeiptr alignedSize = (size + this->alignment - 1) / this->alignment * this->alignment;
+
+        // Move to a buffer whose regions hold the whole frame; earlier allocations stay in the old buffer
+        if (this->head + alignedSize > this->regionSize)
+            this->createBuffer(std::max(this->regionSize * 2, alignedSize));
+
+        Allocation allocation;
+        allocation.buffer = this->buffer;
+        allocation.offset = this->region * this->regionSize + this->head;
+        allocation.size = size;
+        allocation.data = this->mappedData != NULL ? this->mappedData + allocation.offset : NULL;
+        this->head += alignedSize;
+        return allocation;
+    }
+
+    // Ends the frame after its last command using the allocations was issued, and waits until the GPU
+    // finished reading the region of the next frame.
+    void endFrame() {
+        this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        // Deleted buffers are kept by the driver until the commands reading them complete
+        if (!this->retiredBuffers.empty()) {
+            glDeleteBuffers((GLsizei)this->retiredBuffers.size(), this->retiredBuffers.data());
+            this->retiredBuffers.clear();
+        }
+
+        this->region = (this->region + 1) % FRAME_COUNT;
+        this->head = 0;
+
+        GLsync fence = this->fences[this->region];
+        if (fence == 0)
+            return;
+
+        // Flush the first time, so that the fence is sure to be signaled eventually
+        GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+        while (true) {
+            GLenum result = glClientWaitSync(fence, waitFlags, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED)
+                break;
+            waitFlags = 0;
+        }
+        glDeleteSync(fence);
+        this->fences[this->region] = 0;
+    }
+
+    // Returns the size of each region of the ring (in bytes).
+    GLsizeiptr getRegionSize() {
+        return this->regionSize;
+    }
+};
@@ -9,30 +9,33 @@ private:
     GLuint textureID;
     // Texture unit used by the texture (i.e., GL_TEXTURE0)
     GLuint textureUnit;
+    // Target the texture is bound to (i.e., GL_TEXTURE_2D)
+    GLenum target;
 
 public:
     // Instantiates a Texture object.
     Texture(
         GLuint textureID = 0,
-        GLuint textureUnit = GL_TEXTURE0
+        GLuint textureUnit = GL_TEXTURE0,
+        GLenum target = GL_TEXTURE_2D
     ) {
         this->textureID = textureID;
         this->textureUnit = textureUnit;
+        this->target = target;
     }
 
-    // Binds this Texture object to the current shader in use.
+    // Binds this Texture object to the current shader in use; skipped if it is bound already.
     void bind() {
-        glActiveTexture(textureUnit);
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        GLState::bindTexture(this->textureUnit, this->target, this->textureID);
     }
 
     // Returns the unique ID of this texture.
-    GLuint getTextureID() {
+    GLuint getTextureID() const {
         return this->textureID;
     }
 
     // Returns the texture unit this texture is affiliated with.
-    GLuint getTextureUnit() {
+    GLuint getTextureUnit() const {
         return this->textureUnit;
     }
 };
\ No newline at end of file
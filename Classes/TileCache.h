@@ -0,0 +1,375 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "GLState.h"
+#include "LightClusters.h"
+#include "ObjectBatch.h"
+#include "Shader.h"
+#include "StreamBuffer.h"
+#include "UniformBuffer.h"
+
+/*
+    Tile Cache class implementation. Caches the view of an orthographic camera looking straight down (the
+    top view) in tiles aligned to the world, so that panning the camera reuses the pixels of the previous
+    frames. Tiles are squares of the camera's view plane rendered at the window's pixel density, each into
+    a slot of an atlas; a tile's slot is its index wrapped around the slot count, so that the tiles around
+    the camera never share a slot. A composite pass then copies the visible tiles over the window (see
+    tiles.frag).
+
+    A tile is rendered when it becomes visible and its slot holds another tile, or when a tracked model
+    that moved touches it. Every tile is rendered again when the camera's height, zoom, or orientation
+    change, or after invalidate() (e.g. when the lights change). Tiles only hold the models: the background
+    (the skybox, which does not pan with the camera) is drawn under them. Specular highlights are seen
+    from above the center of each tile.
+ */
+class TileCache {
+private:
+    // A slot of the atlas
+    struct Slot {
+        // Tile held by the slot
+        glm::ivec2 tile;
+        // Flag to determine if the slot holds an up-to-date render of its tile
+        bool isValid;
+    };
+
+    // A model drawn into the tiles
+    struct TrackedModel {
+        Model* model;
+        // Transformation of the model in the last frame
+        glm::mat4 transform;
+        // Sphere enclosing the model in the last frame (in world space)
+        BoundingSphere sphere;
+    };
+
+    // Uniform handles of the composite shader
+    struct CompositeUniforms {
+        Uniform<int> tileAtlas;
+        Uniform<glm::vec2> planeOrigin;
+        Uniform<glm::vec2> planeSize;
+        Uniform<glm::vec2> outputSize;
+        Uniform<glm::vec2> texelsPerUnit;
+        Uniform<int> tileTexels;
+        Uniform<glm::ivec2> slotCount;
+
+        CompositeUniforms(const Shader& shader) {
+            this->tileAtlas = shader.getUniform<int>("tileAtlas");
+            this->planeOrigin = shader.getUniform<glm::vec2>("planeOrigin");
+            this->planeSize = shader.getUniform<glm::vec2>("planeSize");
+            this->outputSize = shader.getUniform<glm::vec2>("outputSize");
+            this->texelsPerUnit = shader.getUniform<glm::vec2>("texelsPerUnit");
+            this->tileTexels = shader.getUniform<int>("tileTexels");
+            this->slotCount = shader.getUniform<glm::ivec2>("slotCount");
+        }
+    };
+    // Cached uniform handles of the composite shader
+    UniformCache<CompositeUniforms> uniforms;
+
+    // Width and height of a tile (in texels)
+    const int TILE_TEXELS = 256;
+    // Largest difference between the camera's matrices of two frames that keeps the layout; panning rounds them slightly
+    const float LAYOUT_TOLERANCE = 1.0e-4f;
+    // Texture unit the atlas is sampled from
+    const GLenum ATLAS_UNIT = GL_TEXTURE0;
+
+    // Shader variants drawing the models, and the shader copying the tiles to the window
+    ShaderVariants* shaders;
+    Shader* compositeShader;
+    // Camera buffer of the frame, bound again once the tiles are rendered
+    UniformBuffer<CameraBlock>* cameraBuffer;
+    // Point lights of the frame, binned again for the camera of every tile
+    LightClusters* lightClusters;
+    // Batch drawing the models into the tiles; shares the depth pre-pass shader and the instance culler
+    ObjectBatch batch;
+
+    // Models drawn into the tiles
+    std::vector<TrackedModel> models;
+
+    // Color and depth of the tiles, with the framebuffer rendering into them
+    GLuint colorAtlas;
+    GLuint depthAtlas;
+    GLuint framebuffer;
+    // Empty vertex array; the fullscreen triangle is generated from the vertex IDs
+    GLuint VAO;
+    // Slots of the atlas, row after row
+    std::vector<Slot> slots;
+    glm::ivec2 slotCount;
+
+    // View matrix of the camera without its translation across the view plane; the tiles are laid out in its view space
+    glm::mat4 planeView;
+    // Projection of the camera; its depth range is shared by every tile
+    glm::mat4 projection;
+    // Far plane distance of the camera
+    float zFar;
+    // Texels of a tile per world unit, across the view plane
+    glm::vec2 texelsPerUnit;
+    // View plane coordinates of the bottom-left corner of the window, and the extent of the window
+    glm::vec2 planeOrigin;
+    glm::vec2 planeSize;
+
+    // Number of tiles rendered in the last frame
+    GLuint renderedTileCount;
+
+    // Returns true if the matrices differ by the tolerance at most.
+    bool isNear(const glm::mat4& a, const glm::mat4& b) {
+        for (int column = 0; column < 4; column++) {
+            glm::vec4 difference = glm::abs(a[column] - b[column]);
+            if (std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)) > LAYOUT_TOLERANCE)
+                return false;
+        }
+        return true;
+    }
+
+    // Returns the tile holding the view plane coordinates.
+    glm::ivec2 computeTile(const glm::vec2& planePosition) {
+        return glm::ivec2(glm::floor(planePosition * this->texelsPerUnit / (float)TILE_TEXELS));
+    }
+
+    // Returns the column and row of a tile's slot; the tiles wrap around the atlas.
+    glm::ivec2 computeSlot(const glm::ivec2& tile) {
+        return ((tile % this->slotCount) + this->slotCount) % this->slotCount;
+    }
+
+    // Returns the slot of a tile.
+    Slot& getSlot(const glm::ivec2& tile) {
+        glm::ivec2 slot = this->computeSlot(tile);
+        return this->slots[slot.x + slot.y * this->slotCount.x];
+    }
+
+    // Marks the cached tiles touched by a sphere (in world space) as out of date.
+    void invalidateSphere(const BoundingSphere& sphere) {
+        glm::vec2 center = glm::vec2(this->planeView * glm::vec4(sphere.center, 1.0f));
+        glm::ivec2 minTile = this->computeTile(center - sphere.radius);
+        glm::ivec2 maxTile = this->computeTile(center + sphere.radius);
+        for (int y = minTile.y; y <= maxTile.y; y++) {
+            for (int x = minTile.x; x <= maxTile.x; x++) {
+                Slot& slot = this->getSlot(glm::ivec2(x, y));
+                if (slot.tile == glm::ivec2(x, y))
+                    slot.isValid = false;
+            }
+        }
+    }
+
+    // Lays out the tiles for the camera of this frame. Every tile is rendered again if the layout changed.
+    void updateLayout(const CameraBlock& camera, GLsizei outputWidth, GLsizei outputHeight) {
+        // The tiles move with the world, so only the translation across the view plane may change freely
+        glm::mat4 planeView = camera.view;
+        planeView[3].x = 0.0f;
+        planeView[3].y = 0.0f;
+
+        // View-space corners of the window; an orthographic projection keeps them at the same place at any depth
+        glm::mat4 inverseProjection = glm::inverse(camera.projection);
+        glm::vec2 bottomLeft = glm::vec2(inverseProjection * glm::vec4(-1.0f, -1.0f, 0.0f, 1.0f));
+        glm::vec2 topRight = glm::vec2(inverseProjection * glm::vec4(1.0f, 1.0f, 0.0f, 1.0f));
+        this->planeOrigin = bottomLeft - glm::vec2(camera.view[3]);
+        this->planeSize = topRight - bottomLeft;
+        glm::vec2 texelsPerUnit = glm::vec2((float)outputWidth, (float)outputHeight) / glm::abs(this->planeSize);
+
+        // The cached tiles keep the layout they were rendered with
+        if (this->isNear(planeView, this->planeView) && this->isNear(camera.projection, this->projection) && texelsPerUnit == this->texelsPerUnit)
+            return;
+
+        this->invalidate();
+        this->planeView = planeView;
+        this->projection = camera.projection;
+        this->zFar = camera.zFar;
+        this->texelsPerUnit = texelsPerUnit;
+    }
+
+    // Finds the models that moved since the last frame, and marks the tiles they left or entered as out of date.
+    void updateModels() {
+        for (TrackedModel& tracked : this->models) {
+            glm::mat4 transform = tracked.model->computeTransMatrix();
+            if (transform == tracked.transform)
+                continue;
+
+            BoundingSphere sphere = tracked.model->computeBoundingSphere();
+            this->invalidateSphere(tracked.sphere);
+            this->invalidateSphere(sphere);
+            tracked.transform = transform;
+            tracked.sphere = sphere;
+        }
+    }
+
+    // Draws every model into the tile's slot of the bound framebuffer. Returns false if the tile could not be drawn this frame.
+    bool renderTile(const glm::ivec2& tile, const glm::ivec2& slotCorner) {
+        // The camera of the tile looks down on its center, from the height of the frame's camera
+        glm::vec2 tileSize = (float)TILE_TEXELS / this->texelsPerUnit;
+        glm::vec2 center = (glm::vec2(tile) + 0.5f) * tileSize;
+        CameraBlock camera = CameraBlock();
+        camera.view = this->planeView;
+        camera.view[3].x = -center.x;
+        camera.view[3].y = -center.y;
+        camera.projection = this->projection;
+        camera.projection[0] = glm::vec4(2.0f / tileSize.x, 0.0f, 0.0f, 0.0f);
+        camera.projection[1] = glm::vec4(0.0f, 2.0f / tileSize.y, 0.0f, 0.0f);
+        camera.projection[3].x = 0.0f;
+        camera.projection[3].y = 0.0f;
+        camera.cameraPos = glm::vec3(glm::inverse(camera.view)[3]);
+        camera.zFar = this->zFar;
+
+        // The model shaders and the culling read the tile's camera
+        StreamBuffer::Allocation allocation = StreamBuffer::shared().allocate(sizeof(CameraBlock));
+        if (allocation.data == NULL)
+            return false;
+        *(CameraBlock*)allocation.data = camera;
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, allocation.buffer, allocation.offset, allocation.size);
+        this->lightClusters->build(camera);
+
+        this->batch.begin(camera);
+        for (TrackedModel& tracked : this->models)
+            tracked.model->submit(this->batch);
+
+        // Nothing covers the tile until the models are drawn; the background shows through
+        GLState::setViewport(slotCorner.x, slotCorner.y, TILE_TEXELS, TILE_TEXELS);
+        glScissor(slotCorner.x, slotCorner.y, TILE_TEXELS, TILE_TEXELS);
+        GLState::setColorMask(true);
+        GLState::setDepthMask(true);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClearDepth(1.0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        this->batch.draw(*this->shaders);
+        this->renderedTileCount++;
+        return true;
+    }
+
+public:
+    // Instantiates a Tile Cache object for a window of the given size; the models are drawn with the shader variants
+    // (see main.frag), the tiles copied with the composite shader (see fullscreen.vert and tiles.frag). The depth
+    // pre-pass shader and the instance culler may be NULL.
+    TileCache(GLsizei outputWidth, GLsizei outputHeight, ShaderVariants* shaders, Shader* compositeShader,
+        UniformBuffer<CameraBlock>* cameraBuffer, LightClusters* lightClusters, Shader* depthShader, InstanceCuller* instanceCuller) {
+        this->shaders = shaders;
+        this->compositeShader = compositeShader;
+        this->cameraBuffer = cameraBuffer;
+        this->lightClusters = lightClusters;
+        this->planeView = glm::mat4(0.0f);
+        this->projection = glm::mat4(0.0f);
+        this->zFar = 0.0f;
+        this->texelsPerUnit = glm::vec2(0.0f);
+        this->planeOrigin = glm::vec2(0.0f);
+        this->planeSize = glm::vec2(0.0f);
+        this->renderedTileCount = 0;
+
+        this->batch.setDepthPrePass(depthShader);
+        this->batch.setInstanceCuller(instanceCuller);
+
+        // A window spans at most this many tiles, plus one, in either direction; one more keeps a ring of cached
+        // tiles around it, so that panning back and forth does not render the same tiles again
+        this->slotCount = glm::ivec2(
+            (outputWidth + TILE_TEXELS - 1) / TILE_TEXELS + 2,
+            (outputHeight + TILE_TEXELS - 1) / TILE_TEXELS + 2
+        );
+        Slot emptySlot;
+        emptySlot.tile = glm::ivec2(0);
+        emptySlot.isValid = false;
+        this->slots.assign(this->slotCount.x * this->slotCount.y, emptySlot);
+
+        GLsizei atlasWidth = this->slotCount.x * TILE_TEXELS;
+        GLsizei atlasHeight = this->slotCount.y * TILE_TEXELS;
+        glGenTextures(1, &this->colorAtlas);
+        GLState::bindTexture(ATLAS_UNIT, GL_TEXTURE_2D, this->colorAtlas);
+        GLState::setActiveTexture(ATLAS_UNIT);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, atlasWidth, atlasHeight);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &this->depthAtlas);
+        GLState::bindTexture(ATLAS_UNIT, GL_TEXTURE_2D, this->depthAtlas);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, atlasWidth, atlasHeight);
+
+        glGenFramebuffers(1, &this->framebuffer);
+        GLState::bindFramebuffer(this->framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->colorAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depthAtlas, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR: Tile cache framebuffer is incomplete." << std::endl;
+        GLState::bindFramebuffer(0);
+
+        glGenVertexArrays(1, &this->VAO);
+    }
+
+    // Adds a model drawn into the tiles; it must outlive the tile cache.
+    void addModel(Model* model) {
+        TrackedModel tracked;
+        tracked.model = model;
+        tracked.transform = model->computeTransMatrix();
+        tracked.sphere = model->computeBoundingSphere();
+        this->models.push_back(tracked);
+    }
+
+    // Returns true if every shader finished building; tiles drawn with a stand-in shader would be kept. Never blocks on the driver.
+    bool isReady() {
+        return this->compositeShader->isReady() && this->shaders->isReady();
+    }
+
+    // Renders every tile again the next time it is visible, e.g. after the lights or the models' assets changed.
+    void invalidate() {
+        for (Slot& slot : this->slots)
+            slot.isValid = false;
+    }
+
+    // Renders the tiles of the orthographic camera's view that are not cached yet or that moving models touch.
+    // The light clusters are left binned for the camera of the last tile rendered.
+    void render(const CameraBlock& camera, GLsizei outputWidth, GLsizei outputHeight) {
+        this->renderedTileCount = 0;
+        this->updateLayout(camera, outputWidth, outputHeight);
+        this->updateModels();
+
+        glm::ivec2 minTile = this->computeTile(glm::min(this->planeOrigin, this->planeOrigin + this->planeSize));
+        glm::ivec2 maxTile = this->computeTile(glm::max(this->planeOrigin, this->planeOrigin + this->planeSize));
+
+        glEnable(GL_SCISSOR_TEST);
+        for (int y = minTile.y; y <= maxTile.y; y++) {
+            for (int x = minTile.x; x <= maxTile.x; x++) {
+                glm::ivec2 tile = glm::ivec2(x, y);
+                Slot& slot = this->getSlot(tile);
+                if (slot.isValid && slot.tile == tile)
+                    continue;
+
+                GLState::bindFramebuffer(this->framebuffer);
+                // A tile that could not be drawn is tried again next frame
+                slot.tile = tile;
+                slot.isValid = this->renderTile(tile, this->computeSlot(tile) * TILE_TEXELS);
+            }
+        }
+        glDisable(GL_SCISSOR_TEST);
+
+        // Bind the camera of the frame again for the passes after this one
+        if (this->renderedTileCount > 0)
+            this->cameraBuffer->bind();
+    }
+
+    // Draws the visible tiles over the bound framebuffer, which covers the window; pixels without a model are kept.
+    void draw(GLsizei outputWidth, GLsizei outputHeight) {
+        GLState::setDepthTest(false);
+        GLState::setBlend(false);
+        GLState::setColorMask(true);
+
+        this->compositeShader->use();
+        const CompositeUniforms& uniforms = this->uniforms.get(*this->compositeShader);
+        GLState::bindTexture(ATLAS_UNIT, GL_TEXTURE_2D, this->colorAtlas);
+        uniforms.tileAtlas.set(ATLAS_UNIT - GL_TEXTURE0);
+        uniforms.planeOrigin.set(this->planeOrigin);
+        uniforms.planeSize.set(this->planeSize);
+        uniforms.outputSize.set(glm::vec2((float)outputWidth, (float)outputHeight));
+        uniforms.texelsPerUnit.set(this->texelsPerUnit);
+        uniforms.tileTexels.set(TILE_TEXELS);
+        uniforms.slotCount.set(this->slotCount);
+
+        GLState::bindVertexArray(this->VAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    // Returns the number of tiles rendered in the last frame.
+    GLuint getRenderedTileCount() {
+        return this->renderedTileCount;
+    }
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <cstring>
+
+/******** UNIFORM BLOCK BINDING POINTS ********/
+// Must match the "binding" layout qualifiers of the uniform blocks in the shaders
+// Binding point of CameraBlock (main.vert, main.frag, skybox.vert, sonar.frag)
+const GLuint CAMERA_BLOCK_BINDING = 0;
+// Binding point of LightsBlock (main.frag)
+const GLuint LIGHTS_BLOCK_BINDING = 1;
+// Binding point of ClusterBlock (main.frag)
+const GLuint CLUSTER_BLOCK_BINDING = 2;
+// Binding point of ShadowBlock (main.frag)
+const GLuint SHADOW_BLOCK_BINDING = 3;
+// Binding point of FogBlock (main.frag, skybox.frag, sonar.frag, contour.frag)
+const GLuint FOG_BLOCK_BINDING = 4;
+
+/******** UNIFORM BLOCK LAYOUTS (STD140) ********/
+// Every vec3 is followed by a float so that the C++ layout matches std140 packing.
+
+// Camera attributes shared by every shader program.
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 cameraPos;
+    float zFar;
+};
+
+// Attributes of a directional light.
+struct DirectionalLightBlock {
+    glm::vec3 position;
+    float ambientStr;
+    glm::vec3 lightColor;
+    float specularStr;
+    glm::vec3 ambientColor;
+    float specularPhong;
+};
+
+// Attributes of a point light; an element of the point light buffer (see LightClusters.h), which matches std140 too.
+struct PointLightBlock {
+    glm::vec3 position;
+    float ambientStr;
+    glm::vec3 lightColor;
+    float specularStr;
+    glm::vec3 ambientColor;
+    float specularPhong;
+    float linear;
+    float quadratic;
+    // Distance beyond which the light is ignored
+    float radius;
+    // Flag to determine if the light's shadow is in the point faces of the shadow atlas (see ShadowMaps.h)
+    GLint castsShadows;
+};
+
+// Lights used by the model shader; point lights are clustered (see LightClusters.h).
+struct LightsBlock {
+    DirectionalLightBlock directionalLight;
+};
+
+// Layout of the light clusters of the camera (see LightClusters.h).
+struct ClusterBlock {
+    // Number of clusters across the screen (x, y) and in depth (z)
+    glm::uvec4 gridSize;
+    // Depth range the slices cover
+    float zNear;
+    float zFar;
+    // Slice of a view-space depth: floor(log(depth) * sliceScale - sliceBias)
+    float sliceScale;
+    float sliceBias;
+};
+
+// Shadow views of the shadow atlas (see ShadowMaps.h).
+struct ShadowBlock {
+    // World space to atlas texture coordinates and depth, for the directional light and each face of the point light
+    glm::mat4 directionalMatrix;
+    glm::mat4 pointMatrices[6];
+    // Bounds of each view's tile in the atlas, inset by half a texel (min u, min v, max u, max v)
+    glm::vec4 directionalRect;
+    glm::vec4 pointRects[6];
+    // World-space offset along the normal before a lookup; the point light's grows with the distance to the light
+    float directionalNormalOffset;
+    float pointNormalOffset;
+    float padding[2];
+};
+
+// Underwater fog of the frame (see Fog.h).
+struct FogBlock {
+    // Color the fog turns to where it is opaque
+    glm::vec3 color;
+    // Fraction of the light scattered away per unit of distance under the water
+    float density;
+    // Height of the water's surface; rays are only fogged below it
+    float surfaceHeight;
+    // Fraction of the skybox covered by the fog's color
+    float skyAmount;
+    float padding[2];
+};
+
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match its std140 layout");
+static_assert(sizeof(PointLightBlock) == 64, "PointLightBlock must match its std140 and std430 layouts");
+static_assert(sizeof(LightsBlock) == 48, "LightsBlock must match its std140 layout");
+static_assert(sizeof(ClusterBlock) == 32, "ClusterBlock must match its std140 layout");
+static_assert(sizeof(ShadowBlock) == 576, "ShadowBlock must match its std140 layout");
+static_assert(sizeof(FogBlock) == 32, "FogBlock must match its std140 layout");
+
+/*
+    Uniform Buffer class implementation. Holds a uniform buffer object bound to a fixed binding point,
+    which is shared by every shader program that declares the matching uniform block.
+ */
+template <typename T>
+class UniformBuffer {
+private:
+    // The Uniform Buffer Object
+    GLuint UBO;
+    // The binding point of the buffer
+    GLuint bindingPoint;
+    // Copy of the last uploaded data; uploading identical data is skipped
+    T uploadedData;
+    // Flag to determine if data was uploaded already
+    bool hasData;
+
+public:
+    // Instantiates a Uniform Buffer object and binds it to its binding point.
+    UniformBuffer(GLuint bindingPoint) {
+        this->bindingPoint = bindingPoint;
+        this->hasData = false;
+
+        // Allocate the buffer once; updates only overwrite its contents
+        glGenBuffers(1, &this->UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        glBindBufferBase(GL_UNIFORM_BUFFER, this->bindingPoint, this->UBO);
+    }
+
+    // Uploads the data to the buffer if it changed since the last upload.
+    void update(const T& data) {
+        if (this->hasData && memcmp(&this->uploadedData, &data, sizeof(T)) == 0)
+            return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, this->UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        this->uploadedData = data;
+        this->hasData = true;
+    }
+
+    // Binds the buffer to its binding point again, after another buffer was bound there.
+    void bind() {
+        glBindBufferBase(GL_UNIFORM_BUFFER, this->bindingPoint, this->UBO);
+    }
+
+    // Returns the unique ID of the buffer.
+    GLuint getBufferID() {
+        return this->UBO;
+    }
+
+    // Returns the binding point of the buffer.
+    GLuint getBindingPoint() {
+        return this->bindingPoint;
+    }
+};
@@ -0,0 +1,69 @@
+/**
+ * Sonar contour fragment shader.
+ * Stretches the flat-colored scene over the window and outlines every depth discontinuity (silhouettes and
+ * overlapping creatures) found in the depth buffer; pixels that nothing was drawn on show the background (see SonarView.h).
+ */
+#version 430 core // Shader version
+
+// Scene drawn by the sonar pass, and its depth
+uniform sampler2D sceneColor;
+uniform sampler2D sceneDepth;
+// Part of the textures holding the scene (in texture coordinates)
+uniform vec2 uvScale;
+// Size of a texel of the textures
+uniform vec2 texelSize;
+// Size of the window (in pixels)
+uniform vec2 outputSize;
+// Terms of the projection matrix turning a depth into a view-space distance (projection[2][2], projection[3][2])
+uniform vec2 depthTerms;
+// Relative change of distance between neighboring texels that counts as a contour
+uniform float contourThreshold;
+// Colors of the contours and of the background
+uniform vec3 contourColor;
+uniform vec3 backgroundColor;
+
+// Underwater fog of the frame (see FogBlock in UniformBuffer.h)
+layout(std140, binding = 4) uniform FogBlock {
+	// Color the fog turns to where it is opaque
+	vec3 fogColor;
+	// Fraction of the light scattered away per unit of distance under the water
+	float fogDensity;
+	// Height of the water's surface; rays are only fogged below it
+	float surfaceHeight;
+	// Fraction of the skybox covered by the fog's color
+	float skyFogAmount;
+};
+
+// Fragment color (R,G,B,A)
+out vec4 FragColor;
+
+// Returns the view-space distance of the texel, clamped to the scene's part of the texture.
+float fetchDistance(ivec2 texel, ivec2 maxTexel) {
+	float depth = texelFetch(sceneDepth, clamp(texel, ivec2(0), maxTexel), 0).r;
+	return depthTerms.y / (depth * 2.0 - 1.0 + depthTerms.x);
+}
+
+void main() {
+	vec2 uv = gl_FragCoord.xy / outputSize * uvScale;
+	ivec2 texel = ivec2(uv / texelSize);
+	ivec2 maxTexel = ivec2(uvScale / texelSize) - 1;
+
+	// Nothing was drawn on the pixel
+	float depth = texelFetch(sceneDepth, min(texel, maxTexel), 0).r;
+	vec3 color = depth < 1.0 ? texture(sceneColor, clamp(uv, texelSize * 0.5, uvScale - texelSize * 0.5)).rgb : backgroundColor;
+
+	// Largest relative change of distance to the four neighbors
+	float distance = fetchDistance(texel, maxTexel);
+	vec4 neighbors = vec4(
+		fetchDistance(texel + ivec2(1, 0), maxTexel), fetchDistance(texel - ivec2(1, 0), maxTexel),
+		fetchDistance(texel + ivec2(0, 1), maxTexel), fetchDistance(texel - ivec2(0, 1), maxTexel)
+	);
+	vec4 changes = abs(neighbors - distance);
+	float change = max(max(changes.x, changes.y), max(changes.z, changes.w)) / distance;
+
+	// Contours fade through the fog like the models do, from the nearest side of the edge
+	float nearest = min(distance, min(min(neighbors.x, neighbors.y), min(neighbors.z, neighbors.w)));
+	vec3 contour = mix(color, contourColor, exp(-fogDensity * nearest));
+
+	FragColor = vec4(change > contourThreshold ? contour : color, 1.0);
+}
@@ -0,0 +1,8 @@
+/**
+ * Depth pre-pass fragment shader for models.
+ * Writes nothing; only the depth of the fragments is kept.
+ */
+#version 430 core // Shader version
+
+void main() {
+}
@@ -0,0 +1,48 @@
+/**
+ * Depth pre-pass vertex shader for models.
+ * Reads the position-only vertex stream; the position is computed exactly like in main.vert and fallback.vert.
+ */
+#version 430 core // Shader version
+
+// Access attributes in different positions
+layout(location = 0) in vec3 aPos;
+// Index of the object being drawn (one per instance, see ObjectBatch.h)
+layout(location = 5) in uint objectIndex;
+
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
+
+// Attributes of a drawn object (see ObjectData in ObjectBatch.h)
+struct ObjectData {
+	// Model Matrix
+	mat4 model;
+	// Normal Matrix
+	mat3 normalMatrix;
+	// Color of the model
+	vec4 color;
+};
+
+// Attributes of every object drawn in the frame
+layout(std430, binding = 0) readonly buffer ObjectBlock {
+	ObjectData objects[];
+};
+
+// The main pass tests for equal depth, so its position must match bit for bit
+invariant gl_Position;
+
+void main() {
+	// Model Matrix of the current object
+	mat4 model = objects[objectIndex].model;
+
+	// Apply projection matrix, view matrix, and model matrix
+	gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
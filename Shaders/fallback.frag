@@ -0,0 +1,15 @@
+/**
+ * Fallback fragment shader for models.
+ * Shows the model color only; stands in for the model shader variants while they are still compiling.
+ */
+#version 430 core // Shader version
+
+// Color of the model
+flat in vec3 objectColor;
+
+// Fragment color (R,G,B,A)
+out vec4 FragColor;
+
+void main() {
+	FragColor = vec4(objectColor, 1.0f);
+}
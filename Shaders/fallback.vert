@@ -0,0 +1,51 @@
+/**
+ * Fallback vertex shader for models.
+ * Always quick to build; stands in for the model shader variants while they are still compiling.
+ */
+#version 430 core // Shader version
+
+// Access attributes in different positions
+layout(location = 0) in vec3 aPos;
+// Index of the object being drawn (one per instance, see ObjectBatch.h)
+layout(location = 5) in uint objectIndex;
+
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
+
+// Attributes of a drawn object (see ObjectData in ObjectBatch.h)
+struct ObjectData {
+	// Model Matrix
+	mat4 model;
+	// Normal Matrix
+	mat3 normalMatrix;
+	// Color of the model
+	vec4 color;
+};
+
+// Attributes of every object drawn in the frame
+layout(std430, binding = 0) readonly buffer ObjectBlock {
+	ObjectData objects[];
+};
+
+// Pass the color of the object to the fragment shader
+flat out vec3 objectColor;
+
+// Same position as the depth pre-pass (see depth.vert)
+invariant gl_Position;
+
+void main() {
+	// Apply projection matrix, view matrix, and model matrix
+	gl_Position = projection * view * objects[objectIndex].model * vec4(aPos, 1.0);
+
+	// Pass the object's color
+	objectColor = objects[objectIndex].color.rgb;
+}
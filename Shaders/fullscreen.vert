@@ -0,0 +1,12 @@
+/**
+ * Fullscreen vertex shader.
+ * Covers the window with a single triangle generated from the vertex IDs; no vertex buffer is bound.
+ * Used by the post-processing passes (see DynamicResolution.h, SonarView.h, and TileCache.h).
+ */
+#version 430 core // Shader version
+
+void main() {
+	// Corners (-1, -1), (3, -1), and (-1, 3); the part outside the window is clipped
+	vec2 position = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID >> 1) * 4 - 1);
+	gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -1,55 +1,71 @@
 /**
  * Fragment shader implementation for textured models.
  *
+ * Specialized at compile time with the following defines (see ObjectBatch.h):
+ * - HAS_NORMAL_MAPPING: the model has a normal map
+ * - HAS_TEXTURE: the model has a texture; models without one show their color
+ * - SHOW_COLOR: the model shows its color instead of its texture
+ * - ALPHA_CUTOUT: the texture has transparent pixels, which are discarded
+ *
  * Adapted from: 
  * - https://learnopengl.com/Lighting/Multiple-lights
  * - https://learnopengl.com/Lighting/Light-casters
  */
-#version 330 core // Shader version
+#version 430 core // Shader version
 
 // Struct that contains directional light attributes
+// Members are ordered so that each vec3 packs with a float (std140)
 struct DirectionalLight {
 	vec3 position;
+	float ambientStr;
 	
 	vec3 lightColor;
-	vec3 ambientColor;
-	float ambientStr;
 	float specularStr;
+	vec3 ambientColor;
 	float specularPhong;
 };
 
-// Struct that contains point light attributes
+// Struct that contains point light attributes (see PointLightBlock in UniformBuffer.h)
 struct PointLight {
     vec3 position;
-    
-    float linear;
-    float quadratic;
+	float ambientStr;
 	
 	vec3 lightColor;
-	vec3 ambientColor;
-	float ambientStr;
 	float specularStr;
+	vec3 ambientColor;
 	float specularPhong;
+
+    float linear;
+    float quadratic;
+	// Distance beyond which the light is ignored
+	float radius;
+	// Flag to determine if the light's shadow is in the point faces of the shadow atlas
+	int castsShadows;
 };
 
+// Models showing their color skip texturing and lighting altogether
+#if defined(HAS_TEXTURE) && !defined(SHOW_COLOR)
+#define USE_TEXTURE
+#endif
+
+#ifdef USE_TEXTURE
 // Texture unit for model texture
 uniform sampler2D tex0;
 
+// Depth atlas of the shadow views (see ShadowMaps.h); compares the depth of a lookup
+layout(binding = 14) uniform sampler2DShadow shadowAtlas;
+#endif
+
+#ifdef HAS_NORMAL_MAPPING
 // Texture unit for normal mapping
 uniform sampler2D norm_tex0;
 
-// If the current model has normal mapping or not
-uniform bool hasNormalMapping;
-// If the current model has texture/s or not
-uniform bool hasTexture;
-// If the current model must use its color instead
-uniform bool showColor;
-
 // TBN matrix for normal mapping
 in mat3 TBN;
+#endif
 
 // Color of the model
-uniform vec3 modelColor;
+flat in vec3 objectColor;
 
 // Texture Coordinates
 in vec2 texCoord;
@@ -58,60 +74,173 @@ in vec3 normCoord;
 // Fragment Position
 in vec3 fragPos;
 
+// Skybox behind the fog (see Skybox.h); distant models fade into it
+layout(binding = 13) uniform samplerCube fogSkybox;
+
 // Fragment color (R,G,B,A)
 out vec4 FragColor;
 
-// Camera Position
-uniform vec3 cameraPos;
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
+
+// Lights to be used (see LightsBlock in UniformBuffer.h)
+layout(std140, binding = 1) uniform LightsBlock {
+	DirectionalLight directionalLight;
+};
+
+// Layout of the light clusters of the camera (see ClusterBlock in UniformBuffer.h)
+layout(std140, binding = 2) uniform ClusterBlock {
+	// Number of clusters across the screen (x, y) and in depth (z)
+	uvec4 gridSize;
+	// Depth range the slices cover
+	float clusterNear;
+	float clusterFar;
+	// Slice of a view-space depth: floor(log(depth) * sliceScale - sliceBias)
+	float sliceScale;
+	float sliceBias;
+};
+
+// Point lights of the frame (see LightClusters.h)
+layout(std430, binding = 3) readonly buffer PointLightBlock {
+	PointLight pointLights[];
+};
 
-// Lights to be used
-uniform PointLight pointLight;
-uniform DirectionalLight directionalLight;
+// Range of the light index list of every cluster (offset, count)
+layout(std430, binding = 4) readonly buffer ClusterLightBlock {
+	uvec2 clusters[];
+};
+
+// Indices of the point lights of every cluster, one cluster after another
+layout(std430, binding = 5) readonly buffer LightIndexBlock {
+	uint lightIndices[];
+};
+
+// Shadow views of the shadow atlas (see ShadowBlock in UniformBuffer.h)
+layout(std140, binding = 3) uniform ShadowBlock {
+	// World space to atlas texture coordinates and depth, for the directional light and each face of the point light
+	mat4 directionalShadowMatrix;
+	mat4 pointShadowMatrices[6];
+	// Bounds of each view's tile in the atlas (min u, min v, max u, max v)
+	vec4 directionalShadowRect;
+	vec4 pointShadowRects[6];
+	// World-space offset along the normal before a lookup; the point light's grows with the distance to the light
+	float directionalNormalOffset;
+	float pointNormalOffset;
+};
+
+// Underwater fog of the frame (see FogBlock in UniformBuffer.h)
+layout(std140, binding = 4) uniform FogBlock {
+	// Color the fog turns to where it is opaque
+	vec3 fogColor;
+	// Fraction of the light scattered away per unit of distance under the water
+	float fogDensity;
+	// Height of the water's surface; rays are only fogged below it
+	float surfaceHeight;
+	// Fraction of the skybox covered by the fog's color
+	float skyFogAmount;
+};
 
 // Function prototypes for respective light types
-vec3 computePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 computeDirectLight(DirectionalLight light, vec3 normal, vec3 viewDir);
+vec3 computePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow);
+vec3 computeDirectLight(DirectionalLight light, vec3 normal, vec3 viewDir, float shadow);
+float computeDirectShadow(vec3 surfaceNormal, vec3 fragPos);
+float computePointShadow(PointLight light, vec3 surfaceNormal, vec3 fragPos);
+uint findCluster(vec3 fragPos);
+vec3 applyFog(vec3 color, vec3 fragPos);
 
 void main() {
+#ifdef USE_TEXTURE
 	// Normalize the received normals coordinates
 	vec3 normal;
 	
-	if (hasNormalMapping) {
-		normal = texture(norm_tex0, texCoord).rgb;
-		normal = normalize(normal * 2.0 - 1.0);
-		normal = normalize(TBN * normal);
-	} else {
-		normal = normalize(normCoord);
-	}
+#ifdef HAS_NORMAL_MAPPING
+	normal = texture(norm_tex0, texCoord).rgb;
+	normal = normalize(normal * 2.0 - 1.0);
+	normal = normalize(TBN * normal);
+#else
+	normal = normalize(normCoord);
+#endif
 
 	// Get the view direction from the camera to the fragment
 	vec3 viewDir = normalize(cameraPos - fragPos);
     
+	// Shadow lookups are offset along the surface's own normal, not the normal map's
+	vec3 surfaceNormal = normalize(normCoord);
+
 	// Compute for all the lights needed
-	vec3 result = computeDirectLight(directionalLight, normal, viewDir);
-	result += computePointLight(pointLight, normal, fragPos, viewDir);
+	vec3 result = computeDirectLight(directionalLight, normal, viewDir, computeDirectShadow(surfaceNormal, fragPos));
+
+	// Only the point lights whose radius may reach the fragment's cluster are tested
+	uvec2 cluster = clusters[findCluster(fragPos)];
+	for (uint i = 0u; i < cluster.y; i++) {
+		PointLight light = pointLights[lightIndices[cluster.x + i]];
+		if (distance(light.position, fragPos) < light.radius) {
+			float shadow = light.castsShadows != 0 ? computePointShadow(light, surfaceNormal, fragPos) : 1.0f;
+			result += computePointLight(light, normal, fragPos, viewDir, shadow);
+		}
+	}
 
 	// Apply everything to the fragment
-	// If model has textures, apply texture
-	if (!showColor && hasTexture) {
-        // Get current pixel color
-        vec4 pixelColor = texture(tex0, texCoord);
-
-        // Alpha Cutoff
-        if (pixelColor.a < 0.1) {
-            // Discard every pixel below 0.1 in alpha
-            discard;
-        }
-        
-		FragColor = vec4(result, 1.0f) * pixelColor;       
+	// Get current pixel color
+	vec4 pixelColor = texture(tex0, texCoord);
+
+#ifdef ALPHA_CUTOUT
+	// Alpha Cutoff
+	if (pixelColor.a < 0.1) {
+		// Discard every pixel below 0.1 in alpha
+		discard;
+	}
+#endif
+
+	FragColor = vec4(result, 1.0f) * pixelColor;
+	FragColor.rgb = applyFog(FragColor.rgb, fragPos);
+#else
 	// If model has no textures OR model color is toggled, show color only
-	} else {
-		FragColor = vec4(modelColor, 1.0f);
+	FragColor = vec4(applyFog(objectColor, fragPos), 1.0f);
+#endif
+}
+
+// Returns the color seen through the fog between the camera and the fragment; it fades into the fogged skybox behind.
+vec3 applyFog(vec3 color, vec3 fragPos) {
+	// Orthographic cameras cast parallel rays along the view direction, perspective ones from the camera position
+	vec3 rayDir;
+	vec3 rayStart;
+	float rayLength;
+	if (projection[3][3] == 1.0) {
+		rayDir = -vec3(view[0][2], view[1][2], view[2][2]);
+		rayLength = -(view * vec4(fragPos, 1.0)).z;
+		rayStart = fragPos - rayDir * rayLength;
+	}
+	else {
+		rayDir = normalize(fragPos - cameraPos);
+		rayLength = distance(cameraPos, fragPos);
+		rayStart = cameraPos;
 	}
+
+	// Only the part of the ray below the surface is fogged
+	float lowest = min(rayStart.y, fragPos.y);
+	float highest = max(rayStart.y, fragPos.y);
+	float underwaterLength = rayLength;
+	if (lowest >= surfaceHeight)
+		underwaterLength = 0.0;
+	else if (highest > surfaceHeight)
+		underwaterLength *= (surfaceHeight - lowest) / (highest - lowest);
+
+	vec3 background = mix(texture(fogSkybox, rayDir).rgb, fogColor, skyFogAmount);
+	return mix(background, color, exp(-fogDensity * underwaterLength));
 }
 
 // Compute for point light.
-vec3 computePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
+vec3 computePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, float shadow) {
 	// Get the direction of the light to the fragment
 	vec3 surfaceToLightDir = normalize(light.position - fragPos);
 	// Apply diffuse
@@ -130,14 +259,61 @@ vec3 computePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir
 	float attenuation = 1.0f / (1.0f + light.linear * distance + light.quadratic * (distance * distance));
     // Apply attentuation
     ambientCol *= attenuation;
-    diffuse *= attenuation;
-    specColor *= attenuation;
+    diffuse *= attenuation * shadow;
+    specColor *= attenuation * shadow;
 
 	return (ambientCol + diffuse + specColor);
 }
 
+#ifdef USE_TEXTURE
+// Returns the fraction of the directional light reaching the fragment (1 outside of its shadow view).
+float computeDirectShadow(vec3 surfaceNormal, vec3 fragPos) {
+	vec4 shadowPos = directionalShadowMatrix * vec4(fragPos + surfaceNormal * directionalNormalOffset, 1.0f);
+	if (any(lessThan(shadowPos.xy, directionalShadowRect.xy)) || any(greaterThan(shadowPos.xy, directionalShadowRect.zw)) || shadowPos.z > 1.0f)
+		return 1.0f;
+
+	return texture(shadowAtlas, shadowPos.xyz);
+}
+
+// Returns the fraction of the point light reaching the fragment, looked up in the face its direction points at.
+float computePointShadow(PointLight light, vec3 surfaceNormal, vec3 fragPos) {
+	vec3 lightToFrag = fragPos - light.position;
+	vec3 axisDistance = abs(lightToFrag);
+	// Faces are ordered +X, -X, +Y, -Y, +Z, -Z
+	int face;
+	if (axisDistance.x >= axisDistance.y && axisDistance.x >= axisDistance.z)
+		face = lightToFrag.x > 0.0f ? 0 : 1;
+	else if (axisDistance.y >= axisDistance.z)
+		face = lightToFrag.y > 0.0f ? 2 : 3;
+	else
+		face = lightToFrag.z > 0.0f ? 4 : 5;
+
+	vec3 offsetPos = fragPos + surfaceNormal * pointNormalOffset * length(lightToFrag);
+	vec4 shadowPos = pointShadowMatrices[face] * vec4(offsetPos, 1.0f);
+	shadowPos.xyz /= shadowPos.w;
+
+	// The offset may cross into a neighboring face; stay on the face's tile
+	vec4 rect = pointShadowRects[face];
+	return texture(shadowAtlas, vec3(clamp(shadowPos.xy, rect.xy, rect.zw), shadowPos.z));
+}
+#endif
+
+// Returns the index of the light cluster containing the fragment (see LightClusters.h).
+uint findCluster(vec3 fragPos) {
+	vec4 viewPos = view * vec4(fragPos, 1.0f);
+	vec4 clipPos = projection * viewPos;
+
+	// Tile of the screen, then slice of the view-space depth
+	vec2 screenPos = clamp(clipPos.xy / clipPos.w * 0.5f + 0.5f, 0.0f, 1.0f);
+	uvec2 tile = min(uvec2(screenPos * vec2(gridSize.xy)), gridSize.xy - 1u);
+	float depth = max(-viewPos.z, clusterNear);
+	uint slice = uint(clamp(floor(log(depth) * sliceScale - sliceBias), 0.0f, float(gridSize.z - 1u)));
+
+	return tile.x + gridSize.x * (tile.y + gridSize.y * slice);
+}
+
 // Compute for directional light.
-vec3 computeDirectLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
+vec3 computeDirectLight(DirectionalLight light, vec3 normal, vec3 viewDir, float shadow) {
 	// Get the direction of the light to the fragment
 	vec3 surfaceToLightDir = normalize(light.position);
 	// Apply diffuse
@@ -152,5 +328,6 @@ vec3 computeDirectLight(DirectionalLight light, vec3 normal, vec3 viewDir) {
 	float spec = pow(max(dot(reflectDir, viewDir), 0.1f), light.specularPhong);
 	vec3 specColor = spec * light.specularStr * light.lightColor;
 
-	return (ambientCol + diffuse + specColor);
+	// The ambient light reaches shadowed surfaces too
+	return (ambientCol + (diffuse + specColor) * shadow);
 }
\ No newline at end of file
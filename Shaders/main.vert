@@ -1,27 +1,54 @@
 /**
  * Vertex shader implementation for textured models.
+ *
+ * Specialized at compile time with the following defines (see ObjectBatch.h):
+ * - HAS_NORMAL_MAPPING: the model has tangents and bitangents, and a normal map
+ *
+ * The position is computed exactly like in depth.vert, so it matches the depth pre-pass.
  * 
  * Adapted from: 
  * - https://learnopengl.com/Lighting/Multiple-lights
  * - https://learnopengl.com/Lighting/Light-casters
  */
-#version 330 core // Shader version
+#version 430 core // Shader version
 
 // Access attributes in different positions
 layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 vertexNormal;
 layout(location = 2) in vec2 aTex;
+#ifdef HAS_NORMAL_MAPPING
 layout(location = 3) in vec3 m_tan;
 layout(location = 4) in vec3 m_btan;
+#endif
+// Index of the object being drawn (one per instance, see ObjectBatch.h)
+layout(location = 5) in uint objectIndex;
 
-// View Matrix
-uniform mat4 view;
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
 
-// Projection Matrix
-uniform mat4 projection;
+// Attributes of a drawn object (see ObjectData in ObjectBatch.h)
+struct ObjectData {
+	// Model Matrix
+	mat4 model;
+	// Normal Matrix
+	mat3 normalMatrix;
+	// Color of the model
+	vec4 color;
+};
 
-// Model Matrix
-uniform mat4 model;
+// Attributes of every object drawn in the frame
+layout(std430, binding = 0) readonly buffer ObjectBlock {
+	ObjectData objects[];
+};
 
 // Pass the coordinates of the textures to the fragment shader
 out vec2 texCoord;
@@ -30,27 +57,43 @@ out vec3 normCoord;
 // Pass the position of the vertex to the fragment shader
 out vec3 fragPos;
 
+#ifdef HAS_NORMAL_MAPPING
 // TBN matrix for normal mapping
 out mat3 TBN;
+#endif
+
+// Pass the color of the object to the fragment shader
+flat out vec3 objectColor;
+
+// Same position as the depth pre-pass (see depth.vert)
+invariant gl_Position;
 
 void main() {
+	// Model Matrix of the current object
+	mat4 model = objects[objectIndex].model;
+
 	// Apply projection matrix, view matrix, and model matrix
 	gl_Position = projection * view * model * vec4(aPos, 1.0);
 
 	// Retrieve texture coordinates
 	texCoord = aTex;
 
-	// Get the Normal Matrix and convert it into a 3x3 matrix
+	// Get the Normal Matrix (computed once per object) and convert it into a 3x3 matrix
 	// And apply the Normal Matrix to the normal data
-	mat3 modelMat = mat3(transpose(inverse(model)));
+	mat3 modelMat = objects[objectIndex].normalMatrix;
 	normCoord = modelMat * vertexNormal;
 
+#ifdef HAS_NORMAL_MAPPING
 	// Compute for TBN matrix
 	vec3 T = normalize(modelMat * m_tan);
 	vec3 B = normalize(modelMat * m_btan);
 	vec3 N = normalize(normCoord);
 	TBN = mat3(T, B, N);
+#endif
 
 	// Apply the Model matrix to the vertex as a vector 3
 	fragPos = vec3(model * vec4(aPos, 1.0));
+
+	// Pass the object's color
+	objectColor = objects[objectIndex].color.rgb;
 }
\ No newline at end of file
@@ -0,0 +1,8 @@
+/**
+ * Occlusion proxy fragment shader.
+ * Writes nothing; occlusion queries only count the fragments passing the depth test.
+ */
+#version 430 core // Shader version
+
+void main() {
+}
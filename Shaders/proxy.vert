@@ -0,0 +1,29 @@
+/**
+ * Occlusion proxy vertex shader.
+ * Stretches a unit cube over an object's bounding box; drawn with occlusion queries only (see OcclusionCuller.h).
+ */
+#version 430 core // Shader version
+
+// Corner of the unit cube (0 to 1 on every axis)
+layout(location = 0) in vec3 aPos;
+
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
+
+// World-space bounding box of the tested object
+uniform vec3 boundsMin;
+uniform vec3 boundsMax;
+
+void main() {
+	// Map the unit cube onto the bounding box
+	gl_Position = projection * view * vec4(mix(boundsMin, boundsMax, aPos), 1.0);
+}
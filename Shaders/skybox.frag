@@ -1,5 +1,5 @@
 // shader version
-#version 330 core
+#version 420 core
 
 // Fragment color (R, G, B, A)
 out vec4 FragColor;
@@ -7,8 +7,8 @@ out vec4 FragColor;
 // Texture Coordinates
 in vec3 texCoord;
 
-// Skybox
-uniform samplerCube skybox;
+// Skybox (see SKYBOX_UNIT in Skybox.h)
+layout(binding = 13) uniform samplerCube skybox;
 
 // Show color flag
 uniform bool showColor;
@@ -16,6 +16,18 @@ uniform bool showColor;
 // Color
 uniform vec3 skyboxColor;
 
+// Underwater fog of the frame (see FogBlock in UniformBuffer.h)
+layout(std140, binding = 4) uniform FogBlock {
+	// Color the fog turns to where it is opaque
+	vec3 fogColor;
+	// Fraction of the light scattered away per unit of distance under the water
+	float fogDensity;
+	// Height of the water's surface; rays are only fogged below it
+	float surfaceHeight;
+	// Fraction of the skybox covered by the fog's color
+	float skyFogAmount;
+};
+
 void main() {
 	// If the skybox uses textures, use the texture
     if (!showColor) {
@@ -24,4 +36,7 @@ void main() {
     } else {
         FragColor = vec4(skyboxColor, 1.0);
     }
+
+    // The skybox is the farthest thing seen through the fog; models at the opaque distance fade into this color
+    FragColor.rgb = mix(FragColor.rgb, fogColor, skyFogAmount);
 }
\ No newline at end of file
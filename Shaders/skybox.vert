@@ -1,19 +1,27 @@
 // shader version
-#version 330 core
+#version 420 core
 
 layout (location = 0) in vec3 aPos;
 
 // Cubemap (from vec2 before)
 out vec3 texCoord;
 
-// Projection Matrix
-uniform mat4 projection;
-
-// View Matrix
-uniform mat4 view;
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+    // Projection Matrix
+    mat4 projection;
+    // View Matrix
+    mat4 view;
+    // Camera Position
+    vec3 cameraPos;
+    // Far plane distance
+    float zFar;
+};
 
 void main() {
-    vec4 pos = projection * view * vec4(aPos, 1.0);
+    // Remove the translation of the view matrix so the skybox stays around the camera
+    mat4 skyView = mat4(mat3(view));
+    vec4 pos = projection * skyView * vec4(aPos, 1.0);
     gl_Position = vec4(pos.x, pos.y, pos.w, pos.w);
     texCoord = aPos;
 }
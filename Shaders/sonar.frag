@@ -0,0 +1,43 @@
+/**
+ * Sonar fragment shader for models.
+ * Outputs the flat color of the object, fading into the background with the distance like the fog of the textured
+ * path (see main.frag); the contours are added afterwards from the depth (see contour.frag).
+ */
+#version 430 core // Shader version
+
+// Color of the model
+flat in vec3 objectColor;
+// Fragment Position
+in vec3 fragPos;
+
+// Camera attributes shared by every shader program (see CameraBlock in UniformBuffer.h)
+layout(std140, binding = 0) uniform CameraBlock {
+	// Projection Matrix
+	mat4 projection;
+	// View Matrix
+	mat4 view;
+	// Camera Position
+	vec3 cameraPos;
+	// Far plane distance
+	float zFar;
+};
+
+// Underwater fog of the frame (see FogBlock in UniformBuffer.h); its color is the sonar's background
+layout(std140, binding = 4) uniform FogBlock {
+	// Color the fog turns to where it is opaque
+	vec3 fogColor;
+	// Fraction of the light scattered away per unit of distance under the water
+	float fogDensity;
+	// Height of the water's surface; rays are only fogged below it
+	float surfaceHeight;
+	// Fraction of the skybox covered by the fog's color
+	float skyFogAmount;
+};
+
+// Fragment color (R,G,B,A)
+out vec4 FragColor;
+
+void main() {
+	// The first POV camera never leaves the water
+	FragColor = vec4(mix(fogColor, objectColor, exp(-fogDensity * distance(cameraPos, fragPos))), 1.0);
+}
@@ -0,0 +1,40 @@
+/**
+ * Tile composite fragment shader.
+ * Copies the cached tiles of the top view to the window: finds the view plane position of the pixel, then the
+ * texel of the tile holding it in the atlas. Pixels that no model was drawn on are discarded (see TileCache.h).
+ */
+#version 430 core // Shader version
+
+// Atlas of the cached tiles
+uniform sampler2D tileAtlas;
+// View plane coordinates of the bottom-left corner of the window, and the extent of the window
+uniform vec2 planeOrigin;
+uniform vec2 planeSize;
+// Size of the window (in pixels)
+uniform vec2 outputSize;
+// Texels of a tile per world unit, across the view plane
+uniform vec2 texelsPerUnit;
+// Width and height of a tile (in texels)
+uniform int tileTexels;
+// Number of slots of the atlas across and up
+uniform ivec2 slotCount;
+
+// Fragment color (R,G,B,A)
+out vec4 FragColor;
+
+void main() {
+	vec2 planePosition = planeOrigin + gl_FragCoord.xy / outputSize * planeSize;
+
+	// Texel of the whole tile grid, then the tile holding it and its slot; the slots wrap around the atlas
+	// Negative operands of % are undefined, so both divisions round down explicitly
+	ivec2 gridTexel = ivec2(floor(planePosition * texelsPerUnit));
+	ivec2 tile = ivec2(floor(vec2(gridTexel) / float(tileTexels)));
+	ivec2 slot = tile - slotCount * ivec2(floor(vec2(tile) / vec2(slotCount)));
+	vec4 color = texelFetch(tileAtlas, slot * tileTexels + gridTexel - tile * tileTexels, 0);
+
+	// Tiles are cleared to a zero alpha; the models draw an opaque alpha
+	if (color.a == 0.0)
+		discard;
+
+	FragColor = vec4(color.rgb, 1.0);
+}
@@ -0,0 +1,39 @@
+/**
+ * Upscaling fragment shader.
+ * Stretches the scene, drawn into part of its texture at a lower resolution, over the window with bilinear
+ * filtering, then sharpens it against its four neighbors to recover some of the detail (see DynamicResolution.h).
+ */
+#version 430 core // Shader version
+
+// Scene drawn by the 3D passes
+uniform sampler2D sceneColor;
+// Part of the texture holding the scene (in texture coordinates)
+uniform vec2 uvScale;
+// Size of a texel of the texture
+uniform vec2 texelSize;
+// Size of the window (in pixels)
+uniform vec2 outputSize;
+// Strength of the sharpening; 0 disables it
+uniform float sharpness;
+
+// Fragment color (R,G,B,A)
+out vec4 FragColor;
+
+// Samples the scene, without filtering in texels outside of its part of the texture.
+vec3 sampleScene(vec2 uv) {
+	return texture(sceneColor, clamp(uv, texelSize * 0.5, uvScale - texelSize * 0.5)).rgb;
+}
+
+void main() {
+	vec2 uv = gl_FragCoord.xy / outputSize * uvScale;
+	vec3 color = sampleScene(uv);
+
+	if (sharpness > 0.0) {
+		// Unsharp mask: push the pixel away from the average of its neighbors
+		vec3 neighbors = sampleScene(uv + vec2(texelSize.x, 0.0)) + sampleScene(uv - vec2(texelSize.x, 0.0)) +
+			sampleScene(uv + vec2(0.0, texelSize.y)) + sampleScene(uv - vec2(0.0, texelSize.y));
+		color = clamp(color + (color - neighbors * 0.25) * sharpness, 0.0, 1.0);
+	}
+
+	FragColor = vec4(color, 1.0);
+}
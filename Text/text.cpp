@@ -12,6 +12,8 @@
 //
 
 #include "text.h"
+#include "../Classes/GLState.h" // skips redundant state changes
+#include "../Classes/StreamBuffer.h" // per-frame vertex data
 //#define STB_IMAGE_IMPLEMENTATION
 //#include "stb_image.h" // Sean Barrett's image loader
 #include <stdio.h>
@@ -25,9 +27,15 @@
 #define ATLAS_COLS 16
 #define ATLAS_ROWS 16
 #define MAX_STRINGS 256
+// floats per vertex: x, y, s, t
+#define VERTEX_FLOATS 4
 
 GLuint font_texture;
+GLuint font_vao; // reads the vertices of every text from the stream buffer
 GLuint font_sp; // shader programme
+GLuint font_vs, font_fs; // shaders of the programme, until it is checked
+bool font_sp_checked = false; // compile/link status of the programme was checked
+bool font_sp_ok = false; // programme compiled and linked successfully
 GLint font_sp_pos_loc = -1;
 GLint font_sp_text_colour_loc;
 Renderable_Text renderable_texts[MAX_STRINGS];
@@ -155,43 +163,65 @@ bool create_font_shaders() {
 		"void main () {"
 		"  gl_FragColor = texture2D (tex, st) * text_colour;"
 		"}";
-	GLuint vs, fs;
-	int params = -1;
 
+	// compile and link without checking the status yet, so the driver can
+	// work in the background; the status is checked by check_font_shaders()
 	printf("creating font shaders...\n");
-	vs = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vs, 1, &vs_str, NULL);
-	glCompileShader(vs);
-	glGetShaderiv(vs, GL_COMPILE_STATUS, &params);
+	font_vs = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(font_vs, 1, &vs_str, NULL);
+	glCompileShader(font_vs);
+	font_fs = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(font_fs, 1, &fs_str, NULL);
+	glCompileShader(font_fs);
+	font_sp = glCreateProgram();
+	glAttachShader(font_sp, font_vs);
+	glAttachShader(font_sp, font_fs);
+	// i do this to improve support across older GL versions
+	glBindAttribLocation(font_sp, 0, "vp");
+	glBindAttribLocation(font_sp, 1, "vt");
+	glLinkProgram(font_sp);
+	return true;
+}
+
+// returns true if the font shader programme is ready to use. never blocks if
+// GL_KHR_parallel_shader_compile is available; until then, texts are not drawn
+bool check_font_shaders() {
+	if (font_sp_checked) {
+		return font_sp_ok;
+	}
+	if (GLAD_GL_KHR_parallel_shader_compile) {
+		int complete = GL_FALSE;
+		glGetProgramiv(font_sp, GL_COMPLETION_STATUS_KHR, &complete);
+		if (GL_TRUE != complete) {
+			return false;
+		}
+	}
+	font_sp_checked = true;
+
+	int params = -1;
+	glGetShaderiv(font_vs, GL_COMPILE_STATUS, &params);
 	if (GL_TRUE != params) {
 		fprintf(stderr,
 			"ERROR: font vertex shader did not compile. check version\n");
 		return false;
 	}
-	fs = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fs, 1, &fs_str, NULL);
-	glCompileShader(fs);
-	glGetShaderiv(fs, GL_COMPILE_STATUS, &params);
+	glGetShaderiv(font_fs, GL_COMPILE_STATUS, &params);
 	if (GL_TRUE != params) {
 		fprintf(stderr,
 			"ERROR: font fragment shader did not compile. check version\n");
 		return false;
 	}
-	font_sp = glCreateProgram();
-	glAttachShader(font_sp, vs);
-	glAttachShader(font_sp, fs);
-	// i do this to improve support across older GL versions
-	glBindAttribLocation(font_sp, 0, "vp");
-	glBindAttribLocation(font_sp, 1, "vt");
-	glLinkProgram(font_sp);
 	glGetProgramiv(font_sp, GL_LINK_STATUS, &params);
 	if (GL_TRUE != params) {
 		fprintf(stderr,
 			"ERROR: could not link font shader programme\n");
 		return false;
 	}
+	glDeleteShader(font_vs);
+	glDeleteShader(font_fs);
 	font_sp_text_colour_loc = glGetUniformLocation(font_sp, "text_colour");
 	font_sp_pos_loc = glGetUniformLocation(font_sp, "pos");
+	font_sp_ok = true;
 	return true;
 }
 
@@ -219,17 +249,29 @@ bool init_text_rendering(
 	if (!load_font(font_image_file, font_meta_data_file)) {
 		return false;
 	}
+
+	// one VAO for every text; the vertex buffer is bound when drawing, as the
+	// vertices move to a different part of the stream buffer every frame
+	glGenVertexArrays(1, &font_vao);
+	GLState::bindVertexArray(font_vao);
+	glVertexAttribFormat(0, 2, GL_FLOAT, GL_FALSE, 0);
+	glVertexAttribBinding(0, 0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribFormat(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float));
+	glVertexAttribBinding(1, 0);
+	glEnableVertexAttribArray(1);
+	GLState::bindVertexArray(0);
 	return true;
 }
 
 //
-// create a VBO from a string of text, using our font's glyph sizes to make a
-// set of quads
-void text_to_vbo(
+// create the vertices of a string of text, using our font's glyph sizes to make
+// a set of quads. no GL calls; the vertices are streamed when drawing
+void text_to_vertices(
 	const char* str,
 	float scale_px,
-	GLuint* points_vbo,
-	GLuint* texcoords_vbo,
+	float** vertices,
+	int* vertex_capacity,
 	int* point_count,
 	float* br_x,
 	float* br_y
@@ -317,20 +359,18 @@ void text_to_vbo(
 
 		curr_index++;
 	}
-	glBindBuffer(GL_ARRAY_BUFFER, *points_vbo);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		curr_index * 12 * sizeof(float),
-		points_tmp,
-		GL_DYNAMIC_DRAW
-	);
-	glBindBuffer(GL_ARRAY_BUFFER, *texcoords_vbo);
-	glBufferData(
-		GL_ARRAY_BUFFER,
-		curr_index * 12 * sizeof(float),
-		texcoords_tmp,
-		GL_DYNAMIC_DRAW
-	);
+	// interleave the points and texture coordinates, only growing the storage
+	if (curr_index * 6 > *vertex_capacity) {
+		*vertex_capacity = curr_index * 6;
+		*vertices = (float*)realloc(*vertices,
+			sizeof(float) * *vertex_capacity * VERTEX_FLOATS);
+	}
+	for (int v = 0; v < curr_index * 6; v++) {
+		(*vertices)[v * VERTEX_FLOATS] = points_tmp[v * 2];
+		(*vertices)[v * VERTEX_FLOATS + 1] = points_tmp[v * 2 + 1];
+		(*vertices)[v * VERTEX_FLOATS + 2] = texcoords_tmp[v * 2];
+		(*vertices)[v * VERTEX_FLOATS + 3] = texcoords_tmp[v * 2 + 1];
+	}
 
 	free(points_tmp);
 	free(texcoords_tmp);
@@ -363,25 +403,14 @@ int add_text(
 	renderable_texts[num_render_strings].tl_x = x;
 	renderable_texts[num_render_strings].tl_y = y;
 	renderable_texts[num_render_strings].size_px = size_in_px;
-	glGenBuffers(1, &renderable_texts[num_render_strings].points_vbo);
-	glGenBuffers(1, &renderable_texts[num_render_strings].texcoords_vbo);
-	text_to_vbo(str, size_in_px,
-		&renderable_texts[num_render_strings].points_vbo,
-		&renderable_texts[num_render_strings].texcoords_vbo,
+	renderable_texts[num_render_strings].vertices = NULL;
+	renderable_texts[num_render_strings].vertex_capacity = 0;
+	text_to_vertices(str, size_in_px,
+		&renderable_texts[num_render_strings].vertices,
+		&renderable_texts[num_render_strings].vertex_capacity,
 		&renderable_texts[num_render_strings].point_count,
 		&renderable_texts[num_render_strings].br_x,
 		&renderable_texts[num_render_strings].br_y);
-	// set up VAO
-	glGenVertexArrays(1, &renderable_texts[num_render_strings].vao);
-	glBindVertexArray(renderable_texts[num_render_strings].vao);
-	glBindBuffer(GL_ARRAY_BUFFER,
-		renderable_texts[num_render_strings].points_vbo);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER,
-		renderable_texts[num_render_strings].texcoords_vbo);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-	glEnableVertexAttribArray(1);
 
 	renderable_texts[num_render_strings].r = r;
 	renderable_texts[num_render_strings].g = g;
@@ -408,11 +437,11 @@ void centre_text(int id, float x, float y) {
 }
 
 bool update_text(int id, const char* str) {
-	// just re-generate the existing VBOs and point count
-	text_to_vbo(str,
+	// just re-generate the existing vertices and point count
+	text_to_vertices(str,
 		renderable_texts[id].size_px,
-		&renderable_texts[id].points_vbo,
-		&renderable_texts[id].texcoords_vbo,
+		&renderable_texts[id].vertices,
+		&renderable_texts[id].vertex_capacity,
 		&renderable_texts[id].point_count,
 		&renderable_texts[id].br_x,
 		&renderable_texts[id].br_y);
@@ -429,17 +458,45 @@ bool change_text_colour(int id, float r, float g, float b, float a) {
 }
 
 void draw_texts() {
-	// always draw on-top of scene
-	glDisable(GL_DEPTH_TEST);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_BLEND);
+	// skip texts until the font shaders finished compiling
+	if (!check_font_shaders()) {
+		return;
+	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, font_texture);
-	glUseProgram(font_sp);
+	// always draw on-top of scene. state is not restored afterwards; whatever
+	// is drawn next sets the state it needs
+	GLState::setDepthTest(false);
+	GLState::setColorMask(true);
+	GLState::setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::setBlend(true);
+
+	// stream the vertices of every text for this frame, one after another
+	int total_points = 0;
 	for (int i = 0; i < num_render_strings; i++) {
-		glBindVertexArray(renderable_texts[i].vao);
+		total_points += renderable_texts[i].point_count;
+	}
+	if (0 == total_points) {
+		return;
+	}
+	StreamBuffer::Allocation allocation = StreamBuffer::shared().allocate(
+		sizeof(float) * total_points * VERTEX_FLOATS);
+	if (!allocation.data) {
+		return;
+	}
+	float* streamed_vertices = (float*)allocation.data;
+	for (int i = 0; i < num_render_strings; i++) {
+		memcpy(streamed_vertices, renderable_texts[i].vertices,
+			sizeof(float) * renderable_texts[i].point_count * VERTEX_FLOATS);
+		streamed_vertices += renderable_texts[i].point_count * VERTEX_FLOATS;
+	}
 
+	GLState::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, font_texture);
+	GLState::useProgram(font_sp);
+	GLState::bindVertexArray(font_vao);
+	glBindVertexBuffer(0, allocation.buffer, allocation.offset,
+		VERTEX_FLOATS * sizeof(float));
+	int first_point = 0;
+	for (int i = 0; i < num_render_strings; i++) {
 		glUniform2f(font_sp_pos_loc,
 			renderable_texts[i].tl_x, renderable_texts[i].tl_y);
 		glUniform4f(font_sp_text_colour_loc,
@@ -448,9 +505,8 @@ void draw_texts() {
 			renderable_texts[i].b,
 			renderable_texts[i].a);
 
-		glDrawArrays(GL_TRIANGLES, 0, renderable_texts[i].point_count);
+		glDrawArrays(GL_TRIANGLES, first_point, renderable_texts[i].point_count);
+		first_point += renderable_texts[i].point_count;
 
 	}
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
 }
\ No newline at end of file
@@ -25,8 +25,9 @@
 #include <GLFW/glfw3.h>
 
 struct Renderable_Text {
-	GLuint points_vbo, texcoords_vbo;
-	GLuint vao;
+	// interleaved x, y, s, t of every vertex; streamed to the GPU every frame
+	float* vertices;
+	int vertex_capacity;
 	// top-left screen space coords
 	float tl_x, tl_y;
 	// bottom-right screen space coords. useful for background box sizing
@@ -6,6 +6,8 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <memory>
+#include <random>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -24,13 +26,25 @@
 #include "Text/text.cpp"
 
 /******** ADDITIONAL CLASSES ********/
+#include "Classes/AssetWatcher.h" // AssetWatcher Class
+#include "Classes/GLState.h" // GLState Class
+#include "Classes/StreamBuffer.h" // StreamBuffer Class, per-frame data ring
+#include "Classes/FrameGraph.h" // FrameGraph Class
 #include "Classes/Shader.h"  // Shader Class
+#include "Classes/DynamicResolution.h" // DynamicResolution Class
+#include "Classes/UniformBuffer.h" // UniformBuffer Class, uniform block layouts
 #include "Classes/Camera.h"  // Camera, PerspectiveCamera, OrthoCamera Classes
+#include "Classes/LightClusters.h" // LightClusters Class
 #include "Classes/Light.h"   // Light, PointLight, DirectionalLight Classes
+#include "Classes/Fog.h"     // Fog Class
 #include "Classes/Texture.h" // Texture Class
+#include "Classes/ObjectBatch.h" // ObjectBatch Class, per-object data layout
 #include "Classes/Model.h"   // 3D Model Class
 #include "Classes/Skybox.h"  // Skybox Class
 #include "Classes/Player.h"  // Player Class
+#include "Classes/ShadowMaps.h" // ShadowMaps Class
+#include "Classes/SonarView.h" // SonarView Class
+#include "Classes/TileCache.h" // TileCache Class
 
 /******** 3D MODELS ********/
 // Submarine (player) model, texture, and normal map paths
@@ -103,6 +117,19 @@ std::vector<std::vector<glm::vec3>> enemyConfigs{
      glm::vec3(1.0f)}
 };
 
+/******** CREATURE SCHOOLS ********/
+// Index of each school's creature in the vector of 3D enemy models and textures paths
+std::vector<int> schoolEnemies{
+    0, // Angler fish
+    2  // Peeper
+};
+
+// Vector of creature school configurations (number of creatures, scale of a creature, and min and max distance from the submarine)
+std::vector<glm::vec4> schoolConfigs{
+    glm::vec4(500.0f, 4.0f, 100.0f, 800.0f),  // Angler fish
+    glm::vec4(2000.0f, 0.025f, 60.0f, 800.0f) // Peeper
+};
+
 /******** SKYBOX ********/
 // Ocean depth/floor skybox faces
 std::vector<std::string> whirlpoolSkyboxFaces{
@@ -123,6 +150,35 @@ const char* fragPath = "Shaders/main.frag";
 const char* skyboxVertPath = "Shaders/skybox.vert";
 const char* skyboxFragPath = "Shaders/skybox.frag";
 
+// Fallback 3D model shader paths; used while the 3D model shaders are still compiling
+const char* fallbackVertPath = "Shaders/fallback.vert";
+const char* fallbackFragPath = "Shaders/fallback.frag";
+
+// Depth pre-pass shader paths; draws the depth of the 3D models before they are shaded
+const char* depthVertPath = "Shaders/depth.vert";
+const char* depthFragPath = "Shaders/depth.frag";
+
+// Occlusion proxy shader paths; draws bounding boxes for occlusion queries
+const char* proxyVertPath = "Shaders/proxy.vert";
+const char* proxyFragPath = "Shaders/proxy.frag";
+
+// Instance culling compute shader path; culls the creatures of the schools on the GPU
+const char* cullCompPath = "Shaders/cull.comp";
+
+// Fullscreen vertex shader path; shared by the post-processing passes
+const char* fullscreenVertPath = "Shaders/fullscreen.vert";
+
+// Upscaling shader path; stretches the scene drawn at a lower resolution to the window
+const char* upscaleFragPath = "Shaders/upscale.frag";
+
+// Sonar shader paths; draws the first POV in flat colors, then outlines the creatures
+const char* sonarVertPath = "Shaders/sonar.vert";
+const char* sonarFragPath = "Shaders/sonar.frag";
+const char* contourFragPath = "Shaders/contour.frag";
+
+// Tile composite shader path; copies the cached tiles of the top view to the window
+const char* tilesFragPath = "Shaders/tiles.frag";
+
 /*
     Main (driver) function.
  */
@@ -148,12 +204,66 @@ int main(void) {
     // Initialize GLAD
     gladLoadGL();
 
-    /******** PREPARE SKYBOX ********/
-    Skybox whirlpoolSkybox = Skybox(whirlpoolSkyboxFaces);
+    // Let the driver compile shaders on as many threads as it likes
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
 
     /******** PREPARE SHADERS ********/
-    Shader mainShaderProgram = Shader(vertPath, fragPath);               // 3D model shader
+    // Shaders are submitted first; they compile in the background while the assets load
+    Shader fallbackShaderProgram = Shader(fallbackVertPath, fallbackFragPath); // fallback 3D model shader
+    // 3D model shader; specialized per combination of object flags (normal mapping, texture, color)
+    ShaderVariants mainShaderVariants = ShaderVariants(
+        vertPath,
+        fragPath,
+        std::vector<std::string>(std::begin(OBJECT_FLAG_DEFINES), std::end(OBJECT_FLAG_DEFINES)),
+        &fallbackShaderProgram
+    );
+    // Submit the variants used by the models right away
+    mainShaderVariants.build({
+        OBJECT_HAS_TEXTURE | OBJECT_HAS_NORMAL_MAPPING, // player model
+        OBJECT_HAS_TEXTURE,                             // enemy models
+        OBJECT_HAS_TEXTURE | OBJECT_ALPHA_CUTOUT,       // enemy models with transparent pixels
+        OBJECT_SHOW_COLOR                               // enemy models in first POV
+    });
     Shader skyboxShaderProgram = Shader(skyboxVertPath, skyboxFragPath); // skybox shader
+    Shader proxyShaderProgram = Shader(proxyVertPath, proxyFragPath);    // occlusion proxy shader
+    Shader depthShaderProgram = Shader(depthVertPath, depthFragPath);    // depth pre-pass shader
+    Shader cullShaderProgram = Shader(cullCompPath);                     // instance culling shader
+    Shader upscaleShaderProgram = Shader(fullscreenVertPath, upscaleFragPath); // upscaling shader
+    Shader sonarShaderProgram = Shader(sonarVertPath, sonarFragPath);          // first POV sonar shader
+    Shader contourShaderProgram = Shader(fullscreenVertPath, contourFragPath); // first POV contour shader
+    Shader tilesShaderProgram = Shader(fullscreenVertPath, tilesFragPath);     // top view tile composite shader
+
+    /******** PREPARE SKYBOX ********/
+    Skybox whirlpoolSkybox = Skybox(whirlpoolSkyboxFaces);
+
+    /******** PREPARE PER-FRAME UNIFORM BUFFERS ********/
+    // Camera and light attributes; written once per frame and shared by every shader program
+    CameraBlock cameraBlock = CameraBlock();
+    LightsBlock lightsBlock = LightsBlock();
+    UniformBuffer<CameraBlock> cameraBuffer = UniformBuffer<CameraBlock>(CAMERA_BLOCK_BINDING);
+    UniformBuffer<LightsBlock> lightsBuffer = UniformBuffer<LightsBlock>(LIGHTS_BLOCK_BINDING);
+    // Underwater fog; tuned to the submarine's depth every frame
+    Fog fog = Fog();
+    FogBlock fogBlock = FogBlock();
+    UniformBuffer<FogBlock> fogBuffer = UniformBuffer<FogBlock>(FOG_BLOCK_BINDING);
+    // Point lights; binned into clusters of the camera's view volume every frame
+    LightClusters lightClusters = LightClusters();
+
+    /******** PREPARE OBJECT BATCH ********/
+    // Per-object attributes of every model drawn in a frame; models sharing a mesh are drawn as instances
+    ObjectBatch objectBatch = ObjectBatch();
+    // Shade every pixel of the models once; overlapping creatures are resolved by a depth-only pass first
+    objectBatch.setDepthPrePass(&depthShaderProgram);
+    // Occlusion queries for the models that opt in; results are used in the following frames
+    OcclusionCuller occlusionCuller = OcclusionCuller(&proxyShaderProgram);
+    objectBatch.setOcclusionCuller(&occlusionCuller);
+    // CPU depth pyramid of a few large occluders; objects behind them are culled before any GL submission
+    SoftwareOcclusionCuller softwareCuller;
+    objectBatch.setSoftwareOcclusionCuller(&softwareCuller);
+    // Creatures of the schools are culled one by one on the GPU, straight into the indirect draw commands
+    InstanceCuller instanceCuller = InstanceCuller(&cullShaderProgram);
+    objectBatch.setInstanceCuller(&instanceCuller);
 
     /******** PREPARE DIRECTIONAL LIGHT ********/
     DirectionalLight directionalLight = DirectionalLight(
@@ -255,6 +365,127 @@ int main(void) {
         );
     }
 
+    // Large creatures are often hidden behind others; test them for occlusion before drawing
+    enemyModels[3].toggleOcclusionCulling(true); // Reaper Leviathan
+    enemyModels[4].toggleOcclusionCulling(true); // Sea Emperor
+
+    // Large creatures hide the smaller ones behind them
+    enemyModels[3].toggleOccluder(true); // Reaper Leviathan
+    enemyModels[4].toggleOccluder(true); // Sea Emperor
+
+    /******** PREPARE CREATURE SCHOOLS ********/
+    // Each school is a single model in instance mode, drawing all of its creatures with one draw call
+    // Creatures are scattered with a fixed seed, so the schools are the same on every run
+    std::mt19937 schoolRandom(1);
+    std::uniform_real_distribution<float> unitRandom(0.0f, 1.0f);
+    std::vector<Model> schoolModels;
+    for (size_t i = 0; i < schoolEnemies.size(); i++) {
+        // Get texture/s of the school's creature
+        std::vector<std::string> schoolTextures;
+        for (size_t j = 1; j < enemies[schoolEnemies[i]].size(); j++) {
+            schoolTextures.push_back(enemies[schoolEnemies[i]][j]);
+        }
+
+        // Store the school, centered on the submarine's initial position
+        schoolModels.emplace_back(
+            enemies[schoolEnemies[i]][0],
+            schoolTextures,
+            submarinePos
+        );
+
+        std::vector<ModelInstance> instances((int)schoolConfigs[i].x);
+        for (ModelInstance& instance : instances) {
+            // Random direction, flattened into a layer around the submarine
+            float height = unitRandom(schoolRandom) * 2.0f - 1.0f;
+            float angle = glm::radians(unitRandom(schoolRandom) * 360.0f);
+            float radius = std::sqrt(1.0f - height * height);
+            glm::vec3 direction = glm::vec3(radius * std::cos(angle), height * 0.25f, radius * std::sin(angle));
+
+            // Random distance, spreading the creatures evenly through the volume between the min and max distances
+            float minDistanceCubed = std::pow(schoolConfigs[i].z, 3.0f);
+            float maxDistanceCubed = std::pow(schoolConfigs[i].w, 3.0f);
+            float distance = std::cbrt(minDistanceCubed + unitRandom(schoolRandom) * (maxDistanceCubed - minDistanceCubed));
+
+            instance.position = direction * distance;
+            instance.rotation = glm::vec3(0.0f, unitRandom(schoolRandom) * 360.0f, 0.0f);
+            instance.scale = glm::vec3(schoolConfigs[i].y * (0.8f + unitRandom(schoolRandom) * 0.4f));
+            instance.color = glm::vec3(0.0f, 1.0f, 0.0f);
+            instance.flags = 0;
+        }
+        schoolModels.back().setInstances(instances);
+    }
+
+    /******** PREPARE TEST LIGHTS ********/
+    // Colored point lights scattered around the submarine's initial position, shown with the L key
+    // Together with brute-force light binning (B key), they check the light clusters: the frames must not change
+    const int testLightCount = 400;
+    const float testLightSpread = 200.0f;
+    std::mt19937 testLightRandom(2);
+    std::vector<PointLight> testLights;
+    for (int i = 0; i < testLightCount; i++) {
+        glm::vec3 offset = glm::vec3(unitRandom(testLightRandom), unitRandom(testLightRandom), unitRandom(testLightRandom)) - 0.5f;
+        glm::vec3 color = glm::vec3(unitRandom(testLightRandom), unitRandom(testLightRandom), unitRandom(testLightRandom));
+        testLights.emplace_back(
+            submarinePos + offset * testLightSpread, // position
+            color,                                   // light color
+            color,                                   // ambient light color
+            0.0f,                                    // ambient light strength
+            1.0f,                                    // specular strength
+            16.0f,                                   // specular phong
+            0.22f,                                   // linear
+            0.2f                                     // quadratic
+        );
+    }
+    // Flag to determine if the test lights are submitted
+    bool showTestLights = false;
+
+    /******** PREPARE SHADOW MAPS ********/
+    // Shadows of the directional light and the submarine's point light; still models are cached across frames
+    ShadowMaps shadowMaps = ShadowMaps(&directionalLight, &pointLight, &cameraBuffer, &depthShaderProgram, &instanceCuller);
+    shadowMaps.addCaster(&playerObj);
+    for (size_t i = 0; i < enemyModels.size(); i++) {
+        shadowMaps.addCaster(&enemyModels[i]);
+    }
+    for (size_t i = 0; i < schoolModels.size(); i++) {
+        shadowMaps.addCaster(&schoolModels[i]);
+    }
+
+    /******** PREPARE TOP VIEW TILE CACHE ********/
+    // The top view only pans, so it is drawn from world-aligned tiles; only newly visible tiles and moving models are rendered
+    TileCache tileCache = TileCache(screenWidth, screenHeight, &mainShaderVariants, &tilesShaderProgram, &cameraBuffer,
+        &lightClusters, &depthShaderProgram, &instanceCuller);
+    tileCache.addModel(&playerObj);
+    for (size_t i = 0; i < enemyModels.size(); i++) {
+        tileCache.addModel(&enemyModels[i]);
+    }
+    for (size_t i = 0; i < schoolModels.size(); i++) {
+        tileCache.addModel(&schoolModels[i]);
+    }
+    // Flag to determine if the frame is drawn from the tile cache
+    bool isTopView = false;
+
+    /******** PREPARE ASSET HOT-RELOAD ********/
+    // Watch shaders, .obj files, and textures; changed assets are reloaded in the background
+    AssetWatcher assetWatcher;
+    fallbackShaderProgram.watchAssets(assetWatcher);
+    mainShaderVariants.watchAssets(assetWatcher);
+    skyboxShaderProgram.watchAssets(assetWatcher);
+    proxyShaderProgram.watchAssets(assetWatcher);
+    depthShaderProgram.watchAssets(assetWatcher);
+    cullShaderProgram.watchAssets(assetWatcher);
+    upscaleShaderProgram.watchAssets(assetWatcher);
+    sonarShaderProgram.watchAssets(assetWatcher);
+    contourShaderProgram.watchAssets(assetWatcher);
+    tilesShaderProgram.watchAssets(assetWatcher);
+    playerObj.watchAssets(assetWatcher);
+    for (size_t i = 0; i < enemyModels.size(); i++) {
+        enemyModels[i].watchAssets(assetWatcher);
+    }
+    for (size_t i = 0; i < schoolModels.size(); i++) {
+        schoolModels[i].watchAssets(assetWatcher);
+    }
+    assetWatcher.start();
+
     // Mouse input variables for player's 3rd POV camera
     bool firstMove = true;                            // Avoids sudden camera movement on first mouse input
     float thirdPOVPrevX = (float)screenWidth / 2.0f;  // Previous mouse X offset
@@ -274,9 +505,12 @@ int main(void) {
     // Previous swap time of light's intensity
     float prevIntSwapTime = 0.0f;
 
+    // Previous swap time of the test lights and of the light binning
+    float prevTestLightSwapTime = 0.0f;
+
     // Enable OpenGL's depth testing to avoid models "overlapping"
     // when using different colors or textures for each model
-    glEnable(GL_DEPTH_TEST);
+    GLState::setDepthTest(true);
 
     // Initialize OpenGL text rendering
     init_text_rendering("Text/freemono.png", "Text/freemono.meta", screenWidth, screenHeight);
@@ -300,69 +534,227 @@ int main(void) {
         a                   // alpha channel value of text color
     );
 
-    while (!glfwWindowShouldClose(window)) {
-        // Clear color and depth buffer per iteration
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        /******** RENDER SKYBOX ********/
-        // Use skybox shader program
-        skyboxShaderProgram.use();
-
-        // Bind current POV camera to skybox shader
-        // Check if current POV camera is player camera (1st or 3rd POV)
-        if (player.isPOVCameraUsed()) {
-            // Check if 1st or 3rd POV camera
-            if (player.isFirstPOVCameraUsed()) {
-                // Render skybox with shade of green for first POV
-                whirlpoolSkybox.toggleColor(true);
-                player.getFirstPOVCamera()->bindToShaderFirstPOV(skyboxShaderProgram, true);
-            }
-            else {
-                // Render skybox with default texture color
-                whirlpoolSkybox.toggleColor(false);
-                player.getThirdPOVCamera()->bindToShader(skyboxShaderProgram, true);
-            }
+    /******** PREPARE DYNAMIC RESOLUTION ********/
+    // The 3D passes are drawn at a lower resolution while the GPU cannot keep up with 60 frames per second
+    DynamicResolution dynamicResolution = DynamicResolution(&upscaleShaderProgram, 1000.0f / 60.0f);
+
+    /******** PREPARE SONAR VIEW ********/
+    // The first POV draws flat-colored creatures at a reduced resolution, outlined from the depth
+    SonarView sonarView = SonarView(&sonarShaderProgram, &contourShaderProgram, whirlpoolSkybox.getColor());
+    // Flag to determine if the frame is drawn through the sonar view
+    bool isSonarView = false;
+
+    /******** PREPARE FRAME GRAPH ********/
+    // Passes declare what they draw into; the graph orders them, binds their targets, and clears the window
+    FrameGraph frameGraph;
+    FrameResource windowColor = frameGraph.importWindowTarget("Window color", screenWidth, screenHeight, GL_RGBA8);
+    FrameResource sceneColor = NO_FRAME_RESOURCE;
+    FrameResource sceneDepth = NO_FRAME_RESOURCE;
+
+    // Shadow atlas tiles whose light or casters moved; renders into the atlas, before the models sample it
+    frameGraph.addPass("Shadows",
+        [&](FrameGraph::Builder& builder) {
+            builder.setSideEffect();
+        },
+        [&](const FrameGraph&) {
+            // The sonar is not lit
+            if (isSonarView)
+                return;
+
+            shadowMaps.setFocus(player.getModel()->getPosition());
+            shadowMaps.render();
         }
-        else {
-            whirlpoolSkybox.toggleColor(false);
-            topViewCamera.bindToShader(skyboxShaderProgram, true);
+    );
+
+    // Top view tiles that are not cached yet or that moving models touch; renders into the tile atlas, after the shadows
+    frameGraph.addPass("Top view tiles",
+        [&](FrameGraph::Builder& builder) {
+            builder.setSideEffect();
+        },
+        [&](const FrameGraph&) {
+            if (isTopView)
+                tileCache.render(cameraBlock, screenWidth, screenHeight);
         }
+    );
 
-        // Draw skybox
-        whirlpoolSkybox.draw(skyboxShaderProgram);
+    // Every submitted model, into the scene targets drawn at the dynamic resolution; clears them first
+    frameGraph.addPass("Models",
+        [&](FrameGraph::Builder& builder) {
+            FrameTextureDesc colorDesc = { screenWidth, screenHeight, GL_RGBA8 };
+            FrameTextureDesc depthDesc = { screenWidth, screenHeight, GL_DEPTH_COMPONENT24 };
+            sceneColor = builder.write(builder.create("Scene color", colorDesc, true), true);
+            sceneDepth = builder.write(builder.create("Scene depth", depthDesc, true), true);
+        },
+        [&](const FrameGraph&) {
+            // The top view draws the models from its tiles
+            if (isTopView)
+                return;
+
+            if (isSonarView)
+                sonarView.draw(objectBatch);
+            else
+                objectBatch.draw(mainShaderVariants);
+        }
+    );
 
-        /******** RENDER MODEL ********/
-        // Use main (model) shader program
-        mainShaderProgram.use();
+    // The skybox is drawn after the models at the far plane, so pixels covered by models are rejected early
+    frameGraph.addPass("Skybox",
+        [&](FrameGraph::Builder& builder) {
+            builder.write(sceneColor);
+            // Attached for the depth test only; the skybox does not write depth
+            builder.write(sceneDepth);
+        },
+        [&](const FrameGraph&) {
+            // Skip the skybox until its shader finished compiling; the sonar shows a plain background instead
+            if (!skyboxShaderProgram.isReady() || isSonarView)
+                return;
+
+            // Use skybox shader program
+            skyboxShaderProgram.use();
+
+            // Render skybox with shade of green for first POV, else with default texture color
+            whirlpoolSkybox.toggleColor(player.isPOVCameraUsed() && player.isFirstPOVCameraUsed());
+
+            // Draw skybox
+            whirlpoolSkybox.draw(skyboxShaderProgram);
+        }
+    );
+
+    // The scene stretched to the window, which it covers entirely; the sonar is outlined on the way
+    frameGraph.addPass("Upscale",
+        [&](FrameGraph::Builder& builder) {
+            builder.read(sceneColor);
+            builder.read(sceneDepth);
+            builder.write(windowColor, true);
+        },
+        [&](const FrameGraph& graph) {
+            GLsizei drawnWidth, drawnHeight;
+            graph.getDrawnSize(sceneColor, drawnWidth, drawnHeight);
+            if (isSonarView)
+                sonarView.drawContours(graph.getTexture(sceneColor), graph.getTexture(sceneDepth), screenWidth, screenHeight,
+                    drawnWidth, drawnHeight, screenWidth, screenHeight, cameraBlock);
+            else
+                dynamicResolution.upscale(graph.getTexture(sceneColor), screenWidth, screenHeight, drawnWidth, drawnHeight, screenWidth, screenHeight);
+        }
+    );
+
+    // The cached tiles of the top view, over the skybox at the window's resolution
+    frameGraph.addPass("Top view",
+        [&](FrameGraph::Builder& builder) {
+            builder.write(windowColor);
+        },
+        [&](const FrameGraph&) {
+            if (isTopView)
+                tileCache.draw(screenWidth, screenHeight);
+        }
+    );
+
+    // All texts (in this case, only the depth text), on top of everything at the window's resolution
+    frameGraph.addPass("Text",
+        [&](FrameGraph::Builder& builder) {
+            builder.write(windowColor);
+        },
+        [&](const FrameGraph&) {
+            draw_texts();
+        }
+    );
+
+    frameGraph.compile();
 
-        // Bind top view camera to main shader if player's POV camera is currently not used
+    while (!glfwWindowShouldClose(window)) {
+        // Swap in the assets that were reloaded since the last frame
+        // Reloading binds resources directly, so the shadowed state is no longer accurate
+        // Reloaded meshes are drawn into the cached shadows again
+        if (assetWatcher.applyPendingReloads()) {
+            GLState::invalidate();
+            shadowMaps.invalidate();
+            tileCache.invalidate();
+        }
+
+        /******** UPDATE PER-FRAME UNIFORM BUFFERS ********/
+        // Tune the fog to the submarine's depth; the cameras see no farther than where it turns opaque
+        fog.update(player.getModel()->getPosition().y);
+        firstPOVCamera.setMaxZFar(fog.computeMaxZFar(firstPOVCamera.getPosition().y, false));
+        thirdPOVCamera.setMaxZFar(fog.computeMaxZFar(thirdPOVCamera.getPosition().y, false));
+        topViewCamera.setMaxZFar(fog.computeMaxZFar(topViewCamera.getPosition().y, true));
+
+        // Bind top view camera if player's POV camera is currently not used
         if (!player.isPOVCameraUsed()) {
-            topViewCamera.bindToShader(mainShaderProgram);
+            topViewCamera.bindToBlock(cameraBlock);
+        }
+
+        // Bind player's POV camera (if used) and point light
+        lightClusters.begin();
+        player.bindToBlocks(cameraBlock, lightClusters);
+        if (showTestLights) {
+            for (PointLight& testLight : testLights)
+                testLight.bindToClusters(lightClusters);
         }
 
+        // Bind directional light
+        directionalLight.bindToBlock(lightsBlock);
+
+        // Bind the fog; the first POV fades into the plain background color of the sonar instead of the water
+        fog.bindToBlock(fogBlock);
+        if (player.isPOVCameraUsed() && player.isFirstPOVCameraUsed()) {
+            fogBlock.color = whirlpoolSkybox.getColor();
+            fogBlock.skyAmount = 1.0f;
+        }
+
+        // Upload the blocks once for both the skybox and model shaders
+        cameraBuffer.update(cameraBlock);
+        lightsBuffer.update(lightsBlock);
+        fogBuffer.update(fogBlock);
+
+        // The first POV is drawn through the sonar view once its shaders are ready
+        isSonarView = player.isPOVCameraUsed() && player.isFirstPOVCameraUsed() && sonarView.isReady();
+
+        // The top view is drawn from the tile cache once its shaders are ready
+        // Tiles are only kept while the top view stays in use; the models and lights may change in the other views
+        isTopView = !player.isPOVCameraUsed() && tileCache.isReady();
+        if (!isTopView)
+            tileCache.invalidate();
+
+        // Bin the point lights for the camera of this frame; the sonar is not lit, and the tile cache bins them per tile
+        if (!isSonarView && !isTopView)
+            lightClusters.build(cameraBlock);
+
+        /******** RENDER MODEL ********/
         // If first POV camera is currently used
         if (player.isPOVCameraUsed() && player.isFirstPOVCameraUsed()) {
             // Render enemy models with shade of green for first POV
             for (int i = 0; i < enemyModels.size(); i++) {
                 enemyModels[i].toggleColor(true);
             }
+            for (size_t i = 0; i < schoolModels.size(); i++) {
+                schoolModels[i].toggleColor(true);
+            }
         }
         else {
             // Third POV or top view camera is used, render enemy models with default texture color
             for (int i = 0; i < enemyModels.size(); i++) {
                 enemyModels[i].toggleColor(false);
             }
+            for (size_t i = 0; i < schoolModels.size(); i++) {
+                schoolModels[i].toggleColor(false);
+            }
         }
 
-        // Bind directional light to shader
-        directionalLight.bindToShader(mainShaderProgram);
+        // Submit every model, unless they are drawn from the tiles of the top view
+        if (!isTopView) {
+            // Submit player model
+            objectBatch.begin(cameraBlock);
+            player.submit(objectBatch);
 
-        // Draw player model
-        player.draw(mainShaderProgram);
+            // Submit enemy models
+            for (size_t i = 0; i < enemyModels.size(); i++) {
+                enemyModels[i].submit(objectBatch);
+            }
 
-        // Draw enemy models
-        for (int i = 0; i < enemyModels.size(); i++) {
-            enemyModels[i].draw(mainShaderProgram);
+            // Submit creature schools
+            for (size_t i = 0; i < schoolModels.size(); i++) {
+                schoolModels[i].submit(objectBatch);
+            }
         }
 
         // Update the text (that was created a while ago) with the current player submarine depth value
@@ -372,8 +764,22 @@ int main(void) {
         std::string formattedPlayerDepth = "DEPTH: " + stream.str();
         update_text(depthCtrID, formattedPlayerDepth.c_str());
 
-        // Draw all texts (in this case, only the depth text)
-        draw_texts();
+        /******** RENDER FRAME ********/
+        // Shadows, top view tiles, models, skybox, upscaling, top view, and text, in the order of the frame graph
+        // The 3D passes are drawn at the resolution picked from the GPU time of the previous frames
+        // The sonar never needs the full resolution
+        if (isSonarView)
+            frameGraph.setResolutionScale(std::min(dynamicResolution.getScale(), sonarView.getResolutionScale()));
+        else
+            frameGraph.setResolutionScale(dynamicResolution.getScale());
+        // The fog fades distant models into the skybox, so it stays bound for every pass
+        whirlpoolSkybox.bindCubemap();
+        dynamicResolution.beginFrame();
+        frameGraph.execute();
+        dynamicResolution.endFrame();
+
+        // Every command reading this frame's streamed data was issued; move on to the next region
+        StreamBuffer::shared().endFrame();
 
         // Swap front and back buffers
         glfwSwapBuffers(window);
@@ -602,13 +1008,38 @@ int main(void) {
                 // Change light intensity between low, medium, and high
                 player.changeLightIntensity();
 
+                // The cached tiles of the top view were lit with the previous intensity
+                tileCache.invalidate();
+
                 // Assign current time as previous time for succeeding inputs
                 prevIntSwapTime = currTime;
             }
         }
+
+        // Toggle the test lights
+        if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
+            double currTime = glfwGetTime();
+            if (currTime - prevTestLightSwapTime > 0.2f) {
+                showTestLights = !showTestLights;
+                tileCache.invalidate();
+                prevTestLightSwapTime = currTime;
+            }
+        }
+
+        // Toggle brute-force light binning; the frame must not change
+        if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+            double currTime = glfwGetTime();
+            if (currTime - prevTestLightSwapTime > 0.2f) {
+                lightClusters.toggleBruteForce(!lightClusters.isBruteForceUsed());
+                std::cout << "LIGHT BINNING: " << (lightClusters.isBruteForceUsed() ? "brute force" : "clustered") << std::endl;
+                tileCache.invalidate();
+                prevTestLightSwapTime = currTime;
+            }
+        }
     }
 
     // Some clean up (OPTIONAL, but recommended)
+    assetWatcher.stop();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     glfwTerminate();